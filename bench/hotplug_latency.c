@@ -0,0 +1,303 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <linux/input.h>
+
+#include <libspacemouse.h>
+
+/* Drives spacemouse_monitor() with uevents from a socketpair, for a device in
+ * a fake sysfs tree of which the devnode is a FIFO, and reports the latency
+ * of each step of plugging in and removing the device. */
+
+#define DEVPATH "/devices/bench/input0/event0"
+#define DEVNAME "input/event0"
+
+static char root[] = "/tmp/spacemouse-bench.XXXXXX";
+
+static double now_us(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static long rss_kib(void)
+{
+  long size, resident = 0;
+  FILE *statm = fopen("/proc/self/statm", "r");
+
+  if (statm != NULL) {
+    if (fscanf(statm, "%ld %ld", &size, &resident) != 2)
+      resident = 0;
+    fclose(statm);
+  }
+
+  return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static int write_file(char const *dir, char const *name, char const *value)
+{
+  char path[512];
+  FILE *file;
+
+  sprintf(path, "%s/%s", dir, name);
+  if ((file = fopen(path, "w")) == NULL)
+    return -1;
+  fputs(value, file);
+
+  return fclose(file);
+}
+
+static int make_tree(char *devnode)
+{
+  char dir[512];
+
+  if (mkdtemp(root) == NULL)
+    return -1;
+
+  sprintf(dir, "%s/sys", root);                 mkdir(dir, 0755);
+  sprintf(dir, "%s/sys/class", root);           mkdir(dir, 0755);
+  sprintf(dir, "%s/sys/class/input", root);     mkdir(dir, 0755);
+  sprintf(dir, "%s/sys/devices", root);         mkdir(dir, 0755);
+  sprintf(dir, "%s/sys/devices/bench", root);   mkdir(dir, 0755);
+  sprintf(dir, "%s/sys/devices/bench/input0", root);
+  mkdir(dir, 0755);
+  sprintf(dir, "%s/sys/devices/bench/input0/id", root);
+  mkdir(dir, 0755);
+  sprintf(dir, "%s/sys%s", root, DEVPATH);      mkdir(dir, 0755);
+  sprintf(dir, "%s/dev", root);                 mkdir(dir, 0755);
+  sprintf(dir, "%s/dev/input", root);           mkdir(dir, 0755);
+
+  sprintf(dir, "%s/sys/devices/bench/input0", root);
+  if (write_file(dir, "name", "Bench SpaceNavigator\n") == -1 ||
+      write_file(dir, "id/vendor", "046d\n") == -1 ||
+      write_file(dir, "id/product", "c626\n") == -1)
+    return -1;
+
+  sprintf(dir, "%s/sys%s", root, DEVPATH);
+  if (write_file(dir, "uevent",
+                 "MAJOR=13\nMINOR=64\nDEVNAME=" DEVNAME "\n") == -1)
+    return -1;
+  strcat(dir, "/device");
+  if (symlink("..", dir) == -1)
+    return -1;
+
+  sprintf(devnode, "%s/dev/" DEVNAME, root);
+
+  return mkfifo(devnode, 0600);
+}
+
+static void remove_tree(char const *devnode)
+{
+  char path[512];
+
+  unlink(devnode);
+  sprintf(path, "%s/sys%s/device", root, DEVPATH);  unlink(path);
+  sprintf(path, "%s/sys%s/uevent", root, DEVPATH);  unlink(path);
+  sprintf(path, "%s/sys%s", root, DEVPATH);         rmdir(path);
+  sprintf(path, "%s/sys/devices/bench/input0/id/vendor", root);
+  unlink(path);
+  sprintf(path, "%s/sys/devices/bench/input0/id/product", root);
+  unlink(path);
+  sprintf(path, "%s/sys/devices/bench/input0/name", root);  unlink(path);
+  sprintf(path, "%s/sys/devices/bench/input0/id", root);    rmdir(path);
+  sprintf(path, "%s/sys/devices/bench/input0", root);       rmdir(path);
+  sprintf(path, "%s/sys/devices/bench", root);  rmdir(path);
+  sprintf(path, "%s/sys/devices", root);        rmdir(path);
+  sprintf(path, "%s/sys/class/input", root);    rmdir(path);
+  sprintf(path, "%s/sys/class", root);          rmdir(path);
+  sprintf(path, "%s/sys", root);                rmdir(path);
+  sprintf(path, "%s/dev/input", root);          rmdir(path);
+  sprintf(path, "%s/dev", root);                rmdir(path);
+  rmdir(root);
+}
+
+static int send_uevent(int fd, char const *action)
+{
+  char msg[256];
+  int len;
+
+  len = sprintf(msg, "%s@" DEVPATH, action) + 1;
+  len += sprintf(msg + len, "ACTION=%s", action) + 1;
+  len += sprintf(msg + len, "DEVPATH=" DEVPATH) + 1;
+  len += sprintf(msg + len, "SUBSYSTEM=input") + 1;
+  len += sprintf(msg + len, "DEVNAME=" DEVNAME) + 1;
+
+  return send(fd, msg, len, 0) == len ? 0 : -1;
+}
+
+static int write_frame(int fd)
+{
+  struct input_event ev[2];
+
+  memset(ev, 0, sizeof ev);
+  ev[0].type = EV_REL;
+  ev[0].code = REL_X;
+  ev[0].value = 100;
+  ev[1].type = EV_SYN;
+  ev[1].code = SYN_REPORT;
+
+  return write(fd, ev, sizeof ev) == sizeof ev ? 0 : -1;
+}
+
+static int compare(void const *a, void const *b)
+{
+  double x = *(double const *)a, y = *(double const *)b;
+
+  return x < y ? -1 : x > y;
+}
+
+static double report(char const *name, double *lat, int n)
+{
+  qsort(lat, n, sizeof *lat, compare);
+
+  printf("%-16s p50 %8.1f  p90 %8.1f  p99 %8.1f  p99.9 %8.1f  max %8.1f us\n",
+         name, lat[n / 2], lat[n * 90 / 100], lat[n * 99 / 100],
+         lat[n * 999 / 1000], lat[n - 1]);
+
+  return lat[n * 99 / 100];
+}
+
+int main(int argc, char **argv)
+{
+  struct spacemouse *mouse, *head;
+  spacemouse_event_t event;
+  char devnode[512];
+  double *add_lat, *event_lat, *remove_lat, t0, p99;
+  int cycles = 10000, warmup, sv[2], fifo, i, id, ret = EXIT_FAILURE;
+  double max_p99 = 0;
+  long rss_start = 0, rss_end;
+
+  if (argc > 1)
+    cycles = atoi(argv[1]);
+  if (argc > 2)
+    max_p99 = atof(argv[2]);
+  if (cycles < 10) {
+    fprintf(stderr, "usage: %s [cycles >= 10] [max add p99 in us]\n",
+            argv[0]);
+    return EXIT_FAILURE;
+  }
+  warmup = cycles / 10;
+
+  add_lat = malloc(cycles * sizeof *add_lat);
+  event_lat = malloc(cycles * sizeof *event_lat);
+  remove_lat = malloc(cycles * sizeof *remove_lat);
+  if (add_lat == NULL || event_lat == NULL || remove_lat == NULL)
+    return EXIT_FAILURE;
+
+  /* fault the pages in now, so they do not count as growth; zeroing would
+   * let the compiler turn malloc into calloc, which does not touch them */
+  for (i = 0; i < cycles; i++)
+    add_lat[i] = event_lat[i] = remove_lat[i] = 1.0;
+
+  if (make_tree(devnode) == -1) {
+    perror("Failed to create fake sysfs tree");
+    return EXIT_FAILURE;
+  }
+
+  /* keeps the FIFO open, so the library's reads do not see end of file */
+  if ((fifo = open(devnode, O_RDWR)) == -1 ||
+      socketpair(AF_UNIX, SOCK_DGRAM, 0, sv) == -1) {
+    perror("Failed to set up fake device");
+    goto out;
+  }
+
+  spacemouse_set_backend(SPACEMOUSE_BACKEND_KERNEL);
+  spacemouse_set_sysroot(root);
+
+  if (spacemouse_monitor_open_fd(sv[0]) < 0 ||
+      spacemouse_device_list(&head, 1) < 0) {
+    fprintf(stderr, "Failed to open monitor\n");
+    goto out;
+  }
+
+  for (i = 0; i < warmup + cycles; i++) {
+    int n = i - warmup;
+
+    if (n == 0)
+      rss_start = rss_kib();
+
+    t0 = now_us();
+    if (send_uevent(sv[1], "add") == -1 ||
+        spacemouse_monitor(&mouse) != SPACEMOUSE_ACTION_ADD) {
+      fprintf(stderr, "cycle %d: no ADD\n", i);
+      goto out;
+    }
+    if (n >= 0)
+      add_lat[n] = now_us() - t0;
+    id = spacemouse_device_get_id(mouse);
+
+    if (spacemouse_device_open(mouse) < 0 || write_frame(fifo) == -1 ||
+        spacemouse_device_read_event(mouse, &event) !=
+        SPACEMOUSE_READ_SUCCESS || event.type != SPACEMOUSE_EVENT_MOTION) {
+      fprintf(stderr, "cycle %d: no event\n", i);
+      goto out;
+    }
+    if (n >= 0)
+      event_lat[n] = now_us() - t0;
+
+    /* the last warmup cycle unplugs the device while it is open, the
+     * removed device is closed when the next one is removed */
+    if (n != -1)
+      spacemouse_device_close(mouse);
+    else if (write_frame(fifo) == -1) {
+      fprintf(stderr, "cycle %d: no event\n", i);
+      goto out;
+    }
+
+    t0 = now_us();
+    if (send_uevent(sv[1], "remove") == -1 ||
+        spacemouse_monitor(&mouse) != SPACEMOUSE_ACTION_REMOVE) {
+      fprintf(stderr, "cycle %d: no REMOVE\n", i);
+      goto out;
+    }
+    if (n >= 0)
+      remove_lat[n] = now_us() - t0;
+
+    /* the removed device stays valid until the next call */
+    if (spacemouse_device_get_id(mouse) != id) {
+      fprintf(stderr, "cycle %d: removed device %d, added %d\n", i,
+              spacemouse_device_get_id(mouse), id);
+      goto out;
+    }
+
+    /* and an open one can still be read */
+    if (n == -1 && (spacemouse_device_read_event(mouse, &event) !=
+                    SPACEMOUSE_READ_SUCCESS ||
+                    event.type != SPACEMOUSE_EVENT_MOTION)) {
+      fprintf(stderr, "cycle %d: no event after REMOVE\n", i);
+      goto out;
+    }
+  }
+
+  /* before sorting, which allocates */
+  rss_end = rss_kib();
+
+  printf("%d add/remove cycles, %d warmup\n", cycles, warmup);
+  p99 = report("uevent -> ADD", add_lat, cycles);
+  report("uevent -> event", event_lat, cycles);
+  report("uevent -> REMOVE", remove_lat, cycles);
+  printf("resident memory growth: %ld KiB\n", rss_end - rss_start);
+
+  ret = EXIT_SUCCESS;
+  if (max_p99 > 0 && p99 > max_p99) {
+    printf("p99 ADD latency above %.1f us\n", max_p99);
+    ret = EXIT_FAILURE;
+  }
+
+out:
+  spacemouse_monitor_close();
+  remove_tree(devnode);
+
+  return ret;
+}
@@ -0,0 +1,44 @@
+#include <array>
+#include <cstdio>
+#include <vector>
+
+#include <libspacemouse.hpp>
+
+int main()
+{
+  libspacemouse::device_list list(true);
+  std::vector<libspacemouse::device> devices;
+  std::array<libspacemouse::event, 64> events;
+
+  if (list.empty())
+    std::printf("No devices found.\n");
+
+  for (libspacemouse::device_ref ref : list) {
+    std::printf("device id: %d\n", ref.id());
+    std::printf("  devnode: %s\n", ref.devnode());
+    std::printf("  manufacturer: %s\n", ref.manufacturer());
+    std::printf("  product: %s\n", ref.product());
+
+    devices.emplace_back(ref);
+  }
+
+  if (devices.empty())
+    return 0;
+
+  /* read from the first device only, in batches */
+  while (1) {
+    std::size_t n = devices.front().read(events);
+
+    for (std::size_t i = 0; i < n; i++) {
+      if (auto m = events[i].motion())
+        std::printf("got motion event: t(%d, %d, %d) r(%d, %d, %d) "
+                    "period(%d)\n", m->x, m->y, m->z, m->rx, m->ry, m->rz,
+                    m->period);
+      else if (auto b = events[i].button())
+        std::printf("got button %s event b(%d)\n",
+                    b->press ? "press" : "release", b->bnum);
+    }
+  }
+
+  return 0;
+}
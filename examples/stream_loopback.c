@@ -0,0 +1,277 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include <libspacemouse.h>
+
+/* Streams events over 127.0.0.1 from a child process to the parent, which
+ * reads them from the remote device like from a local one. The child is run
+ * twice, as a publisher which restarts; its device is listed from a fake
+ * sysfs tree and its events are made up. */
+
+#define PORT 47011
+#define FRAMES 200
+#define FRAMES_PER_FLUSH 10
+
+static char root[] = "/tmp/spacemouse-stream.XXXXXX";
+static char const *dirs[] = {
+  "sys", "sys/class", "sys/class/input", "sys/class/input/event0",
+  "sys/class/input/event0/device", "sys/class/input/event0/device/id"
+};
+static char const *files[][2] = {
+  { "sys/class/input/event0/uevent", "MAJOR=13\nMINOR=64\nDEVNAME=input/event0\n" },
+  { "sys/class/input/event0/device/name", "Streamed SpaceNavigator\n" },
+  { "sys/class/input/event0/device/id/vendor", "046d\n" },
+  { "sys/class/input/event0/device/id/product", "c626\n" }
+};
+#define NDIRS (int)(sizeof dirs / sizeof *dirs)
+#define NFILES (int)(sizeof files / sizeof *files)
+
+static int make_tree(void)
+{
+  char path[256];
+  FILE *file;
+  int i;
+
+  if (mkdtemp(root) == NULL)
+    return -1;
+
+  for (i = 0; i < NDIRS; i++) {
+    sprintf(path, "%s/%s", root, dirs[i]);
+    if (mkdir(path, 0755) == -1)
+      return -1;
+  }
+
+  for (i = 0; i < NFILES; i++) {
+    sprintf(path, "%s/%s", root, files[i][0]);
+    if ((file = fopen(path, "w")) == NULL)
+      return -1;
+    fputs(files[i][1], file);
+    fclose(file);
+  }
+
+  return 0;
+}
+
+static void remove_tree(void)
+{
+  char path[256];
+  int i;
+
+  for (i = NFILES - 1; i >= 0; i--) {
+    sprintf(path, "%s/%s", root, files[i][0]);
+    unlink(path);
+  }
+
+  for (i = NDIRS - 1; i >= 0; i--) {
+    sprintf(path, "%s/%s", root, dirs[i]);
+    rmdir(path);
+  }
+
+  rmdir(root);
+}
+
+static int publish_button(struct spacemouse *mouse, int bnum, int press)
+{
+  spacemouse_event_t event;
+
+  memset(&event, 0, sizeof event);
+  event.type = SPACEMOUSE_EVENT_BUTTON;
+  event.button.bnum = bnum;
+  event.button.press = press;
+
+  return spacemouse_stream_publish(mouse, &event, 0);
+}
+
+/* The publisher announces its device and tells the receiver the device's
+ * maximum axis deviation, waits for the receiver to open it, then sends
+ * motion and a final button release. */
+static int publish(int sync)
+{
+  struct spacemouse *mouse;
+  spacemouse_event_t event;
+  char c;
+  int i, max_axis;
+
+  spacemouse_set_backend(SPACEMOUSE_BACKEND_KERNEL);
+  spacemouse_set_sysroot(root);
+
+  if (spacemouse_device_list(&mouse, 1) < 0 || mouse == NULL ||
+      spacemouse_stream_open("127.0.0.1", PORT) < 0)
+    return EXIT_FAILURE;
+
+  max_axis = spacemouse_device_get_max_axis_deviation(mouse);
+  if (publish_button(mouse, 0, 1) < 0 || spacemouse_stream_flush() < 0 ||
+      write(sync, &max_axis, sizeof max_axis) != sizeof max_axis ||
+      read(sync, &c, 1) != 1)
+    return EXIT_FAILURE;
+
+  memset(&event, 0, sizeof event);
+  event.type = SPACEMOUSE_EVENT_MOTION;
+  for (i = 1; i <= FRAMES; i++) {
+    event.motion.x = i;
+    event.motion.rz = -i;
+    if (spacemouse_stream_publish(mouse, &event, 0) < 0 ||
+        (i % FRAMES_PER_FLUSH == 0 && spacemouse_stream_flush() < 0))
+      return EXIT_FAILURE;
+  }
+
+  if (publish_button(mouse, 0, 0) < 0 || spacemouse_stream_flush() < 0)
+    return EXIT_FAILURE;
+
+  spacemouse_stream_close();
+
+  return EXIT_SUCCESS;
+}
+
+/* Read the remote device until the publisher released its button, returns
+ * the number of motion events or -1. */
+static int read_device(int recv_fd, struct spacemouse *mouse)
+{
+  spacemouse_event_t event;
+  struct spacemouse *other;
+  struct pollfd fds[2];
+  int motions = 0, x = 0, ret;
+
+  fds[0].fd = recv_fd;
+  fds[1].fd = spacemouse_device_get_fd(mouse);
+  fds[0].events = fds[1].events = POLLIN;
+
+  while (1) {
+    if (poll(fds, 2, 5000) <= 0)
+      return -1;
+
+    if (fds[0].revents & POLLIN && spacemouse_stream_receive(&other) < 0)
+      return -1;
+
+    if (!(fds[1].revents & POLLIN))
+      continue;
+
+    if ((ret = spacemouse_device_read_event(mouse, &event)) < 0)
+      return -1;
+    if (ret != SPACEMOUSE_READ_SUCCESS)
+      continue;
+
+    if (event.type == SPACEMOUSE_EVENT_MOTION) {
+      /* coalesced by the publisher, but never out of order */
+      if (event.motion.x <= x)
+        return -1;
+      x = event.motion.x;
+      motions++;
+    } else if (event.type == SPACEMOUSE_EVENT_BUTTON && !event.button.press)
+      break;
+  }
+
+  printf("  %d motion events, last x %d\n", motions, x);
+
+  return x == FRAMES ? motions : -1;
+}
+
+int main()
+{
+  struct spacemouse *mouse;
+  struct spacemouse_stream_stats stats;
+  int recv_fd, sync[2], id[2], run, status, max_axis, ret = EXIT_FAILURE;
+  pid_t pid;
+
+  if (make_tree() == -1) {
+    perror("Failed to create fake sysfs tree");
+    remove_tree();
+    return EXIT_FAILURE;
+  }
+
+  if ((recv_fd = spacemouse_stream_receiver_open("127.0.0.1", PORT)) < 0) {
+    fprintf(stderr, "Failed to open receiver\n");
+    goto out;
+  }
+
+  /* the device of a publisher silent for a second is removed */
+  spacemouse_stream_set_idle_timeout(1);
+
+  for (run = 0; run < 2; run++) {
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sync) == -1 ||
+        (pid = fork()) == -1) {
+      perror("Failed to start publisher");
+      goto out;
+    }
+
+    if (pid == 0) {
+      /* the child's copy of the receiver and its devices */
+      spacemouse_stream_receiver_close();
+      close(sync[1]);
+      _exit(publish(sync[0]));
+    }
+    close(sync[0]);
+
+    /* the first event announces the device, it is dropped as the device is
+     * not open yet */
+    if (spacemouse_stream_receive(&mouse) != SPACEMOUSE_ACTION_ADD ||
+        spacemouse_device_open(mouse) < 0) {
+      fprintf(stderr, "run %d: no device\n", run);
+      goto out;
+    }
+    id[run] = spacemouse_device_get_id(mouse);
+    printf("added %s\n", spacemouse_device_get_devnode(mouse));
+
+    /* a device which can not be queried has none at either end */
+    if (read(sync[1], &max_axis, sizeof max_axis) != sizeof max_axis ||
+        spacemouse_device_get_max_axis_deviation(mouse) !=
+        (max_axis > 0 ? max_axis : -1)) {
+      fprintf(stderr, "run %d: maximum axis deviation not passed on\n", run);
+      goto out;
+    }
+
+    if (write(sync[1], "", 1) != 1 || read_device(recv_fd, mouse) == -1) {
+      fprintf(stderr, "run %d: events lost or out of order\n", run);
+      goto out;
+    }
+    close(sync[1]);
+    spacemouse_device_close(mouse);
+
+    if (waitpid(pid, &status, 0) == -1 || !WIFEXITED(status) ||
+        WEXITSTATUS(status) != EXIT_SUCCESS) {
+      fprintf(stderr, "run %d: publisher failed\n", run);
+      goto out;
+    }
+  }
+
+  /* the restarted publisher has a device of its own, both time out */
+  for (run = 0; run < 2; run++) {
+    if (spacemouse_stream_receive(&mouse) != SPACEMOUSE_ACTION_REMOVE ||
+        spacemouse_device_get_id(mouse) != id[run]) {
+      fprintf(stderr, "run %d: device not removed\n", run);
+      goto out;
+    }
+    printf("removed %s\n", spacemouse_device_get_devnode(mouse));
+  }
+
+  spacemouse_stream_get_stats(&stats);
+  printf("received %lu datagrams, %lu lost, %lu reordered, %lu duplicate, "
+         "%lu invalid\n", stats.packets_received, stats.packets_lost,
+         stats.packets_reordered, stats.packets_duplicate, stats.invalid);
+  printf("%lu events passed on, %lu dropped\n", stats.records_received,
+         stats.records_dropped);
+
+  if (stats.packets_lost != 0 || stats.packets_reordered != 0 ||
+      stats.packets_duplicate != 0 || stats.invalid != 0 ||
+      stats.records_dropped != 2) {
+    fprintf(stderr, "Unexpected counters on loopback\n");
+    goto out;
+  }
+
+  printf("Stream delivered as expected.\n");
+  ret = EXIT_SUCCESS;
+
+out:
+  spacemouse_stream_receiver_close();
+  remove_tree();
+
+  return ret;
+}
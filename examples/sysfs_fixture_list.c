@@ -0,0 +1,173 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <libspacemouse.h>
+
+/* Lists the devices of a fake sysfs tree with the kernel backend: a
+ * SpaceNavigator, which is listed, and a mouse, which is not. */
+
+#define MAX_PATHS 64
+
+static char root[] = "/tmp/spacemouse-fixture.XXXXXX";
+static char paths[MAX_PATHS][256];
+static int path_count = 0;
+
+/* Remember created paths, so they are removed in reverse order. */
+static char *add_path(char const *rel)
+{
+  char *path;
+
+  if (path_count == MAX_PATHS)
+    return NULL;
+
+  path = paths[path_count++];
+  sprintf(path, "%s/%.200s", root, rel);
+
+  return path;
+}
+
+static int make_dir(char const *rel)
+{
+  char *path = add_path(rel);
+
+  return path == NULL ? -1 : mkdir(path, 0755);
+}
+
+static int make_file(char const *rel, char const *value)
+{
+  char *path = add_path(rel);
+  FILE *file;
+
+  if (path == NULL || (file = fopen(path, "w")) == NULL)
+    return -1;
+  fputs(value, file);
+
+  return fclose(file);
+}
+
+static int make_link(char const *target, char const *rel)
+{
+  char *path = add_path(rel);
+
+  return path == NULL ? -1 : symlink(target, path);
+}
+
+static int make_input(char const *input, char const *event,
+                      char const *vendor, char const *product,
+                      char const *name, char const *uevent)
+{
+  char rel[128], target[128];
+
+  sprintf(rel, "sys/devices/fixture/%s", input);
+  if (make_dir(rel) == -1)
+    return -1;
+  sprintf(rel, "sys/devices/fixture/%s/id", input);
+  if (make_dir(rel) == -1)
+    return -1;
+  sprintf(rel, "sys/devices/fixture/%s/id/vendor", input);
+  if (make_file(rel, vendor) == -1)
+    return -1;
+  sprintf(rel, "sys/devices/fixture/%s/id/product", input);
+  if (make_file(rel, product) == -1)
+    return -1;
+  sprintf(rel, "sys/devices/fixture/%s/name", input);
+  if (make_file(rel, name) == -1)
+    return -1;
+  sprintf(rel, "sys/devices/fixture/%s/%s", input, event);
+  if (make_dir(rel) == -1)
+    return -1;
+  sprintf(rel, "sys/devices/fixture/%s/%s/uevent", input, event);
+  if (make_file(rel, uevent) == -1)
+    return -1;
+  sprintf(rel, "sys/devices/fixture/%s/%s/device", input, event);
+  if (make_link("..", rel) == -1)
+    return -1;
+
+  sprintf(target, "../../devices/fixture/%s/%s", input, event);
+  sprintf(rel, "sys/class/input/%s", event);
+  if (make_link(target, rel) == -1)
+    return -1;
+
+  sprintf(rel, "dev/input/%s", event);
+  return make_file(rel, "");
+}
+
+static int make_tree(void)
+{
+  if (mkdtemp(root) == NULL)
+    return -1;
+
+  if (make_dir("sys") == -1 || make_dir("sys/class") == -1 ||
+      make_dir("sys/class/input") == -1 || make_dir("sys/devices") == -1 ||
+      make_dir("sys/devices/fixture") == -1 || make_dir("dev") == -1 ||
+      make_dir("dev/input") == -1)
+    return -1;
+
+  if (make_input("input3", "event3", "046d\n", "c626\n",
+                 "3Dconnexion SpaceNavigator\n",
+                 "MAJOR=13\nMINOR=67\nDEVNAME=input/event3\n") == -1 ||
+      make_input("input4", "event4", "046d\n", "c52b\n",
+                 "Logitech USB Receiver\n",
+                 "MAJOR=13\nMINOR=68\nDEVNAME=input/event4\n") == -1)
+    return -1;
+
+  return 0;
+}
+
+static void remove_tree(void)
+{
+  while (path_count > 0)
+    remove(paths[--path_count]);
+  rmdir(root);
+}
+
+int main()
+{
+  struct spacemouse *iter, *head;
+  char devnode[256];
+  int count = 0, ret = EXIT_FAILURE;
+
+  if (make_tree() == -1) {
+    perror("Failed to create fake sysfs tree");
+    remove_tree();
+    return EXIT_FAILURE;
+  }
+
+  spacemouse_set_backend(SPACEMOUSE_BACKEND_KERNEL);
+  spacemouse_set_sysroot(root);
+
+  if (spacemouse_device_list(&head, 1) < 0) {
+    fprintf(stderr, "Failed to list devices\n");
+    goto out;
+  }
+
+  spacemouse_device_list_foreach(iter, head) {
+    printf("device id: %d\n", spacemouse_device_get_id(iter));
+    printf("  devnode: %s\n", spacemouse_device_get_devnode(iter));
+    printf("  product: %s\n", spacemouse_device_get_product(iter));
+    count++;
+  }
+
+  sprintf(devnode, "%s/dev/input/event3", root);
+  if (count != 1 || strcmp(spacemouse_device_get_devnode(head), devnode) != 0 ||
+      spacemouse_device_get_vendor_id(head) != 0x046d ||
+      spacemouse_device_get_product_id(head) != 0xc626 ||
+      strcmp(spacemouse_device_get_product(head),
+             "3Dconnexion SpaceNavigator") != 0) {
+    fprintf(stderr, "Expected only the SpaceNavigator at %s\n", devnode);
+    goto out;
+  }
+
+  printf("Fixture listed as expected.\n");
+  ret = EXIT_SUCCESS;
+
+out:
+  remove_tree();
+
+  return ret;
+}
@@ -0,0 +1,152 @@
+/*
+Copyright (c) 2013 Rolf Morel
+
+libspacemouse - a free software driver for 3D/6DoF input devices.
+
+libspacemouse is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+libspacemouse is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libspacemouse.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "libspacemouse.h"
+#include "types.h"
+#include "internal.h"
+
+/* Single producer, multi consumer broadcast ring.
+ *
+ * Every slot carries the sequence number (position + 1) of the event it
+ * holds, or 0 while the producer is writing it. Consumers copy a slot and
+ * check its sequence number before and after the copy, like a seqlock, so
+ * the producer never waits on them and a consumer that was lapped notices
+ * that its copy is torn. */
+
+struct broadcast_slot {
+  unsigned long seq;
+  spacemouse_event_t event;
+};
+
+struct broadcast_ring {
+  unsigned long head;
+  unsigned long mask;
+  struct broadcast_slot slots[1];
+};
+
+int spacemouse_device_broadcast_enable(struct spacemouse *mouse,
+                                       unsigned int size)
+{
+  struct broadcast_ring *ring;
+
+  if (size < 2 || (size & (size - 1)) != 0)
+    return -EINVAL;
+
+  if (mouse->broadcast != NULL)
+    return -EBUSY;
+
+  ring = calloc(1, sizeof *ring + (size - 1) * sizeof ring->slots[0]);
+  if (ring == NULL)
+    return -errno;
+
+  ring->mask = size - 1;
+
+  __atomic_store_n(&mouse->broadcast, ring, __ATOMIC_RELEASE);
+
+  return 0;
+}
+
+size_t broadcast_ring_bytes(struct broadcast_ring *ring)
+{
+  return sizeof *ring + ring->mask * sizeof ring->slots[0];
+}
+
+int spacemouse_device_broadcast_disable(struct spacemouse *mouse)
+{
+  /* the reader thread publishes to the ring */
+  if (mouse->reader.running)
+    return -EBUSY;
+
+  free(mouse->broadcast);
+  mouse->broadcast = NULL;
+
+  return 0;
+}
+
+void broadcast_publish(struct broadcast_ring *ring,
+                       spacemouse_event_t const *event)
+{
+  unsigned long pos = ring->head;
+  struct broadcast_slot *slot = &ring->slots[pos & ring->mask];
+
+  __atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  memcpy(&slot->event, event, sizeof slot->event);
+
+  __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+  __atomic_store_n(&ring->head, pos + 1, __ATOMIC_RELEASE);
+}
+
+int spacemouse_subscriber_init(struct spacemouse_subscriber *sub,
+                               struct spacemouse *mouse)
+{
+  struct broadcast_ring *ring = __atomic_load_n(&mouse->broadcast,
+                                                __ATOMIC_ACQUIRE);
+
+  if (ring == NULL)
+    return -EINVAL;
+
+  sub->mouse = mouse;
+  sub->cursor = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  sub->lost = 0;
+
+  return 0;
+}
+
+enum spacemouse_read_result spacemouse_subscriber_read(
+    struct spacemouse_subscriber *sub, spacemouse_event_t *event)
+{
+  struct broadcast_ring *ring = sub->mouse->broadcast;
+  struct broadcast_slot *slot;
+  unsigned long head, seq, size = ring->mask + 1;
+
+  head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  if (sub->cursor == head)
+    return SPACEMOUSE_READ_IGNORE;
+
+  /* lapped, skip to the oldest event still in the ring */
+  if (head - sub->cursor > size) {
+    sub->lost += head - sub->cursor - size;
+    sub->cursor = head - size;
+  }
+
+  slot = &ring->slots[sub->cursor & ring->mask];
+
+  seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+  if (seq == sub->cursor + 1) {
+    memcpy(event, &slot->event, sizeof *event);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq) {
+      sub->cursor++;
+      return SPACEMOUSE_READ_SUCCESS;
+    }
+  }
+
+  /* the producer overwrote the slot under us */
+  sub->lost++;
+  sub->cursor++;
+
+  return SPACEMOUSE_READ_IGNORE;
+}
@@ -0,0 +1,142 @@
+/*
+Copyright (c) 2013 Rolf Morel
+
+libspacemouse - a free software driver for 3D/6DoF input devices.
+
+libspacemouse is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+libspacemouse is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libspacemouse.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+
+#include "libspacemouse.h"
+#include "types.h"
+#include "internal.h"
+
+static long elapsed_us(struct timespec const *start)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (now.tv_sec - start->tv_sec) * 1000000L +
+         (now.tv_nsec - start->tv_nsec) / 1000;
+}
+
+int spacemouse_device_set_busy_poll(struct spacemouse *mouse,
+                                    unsigned int max_budget)
+{
+  int flags;
+
+  if (mouse->fd < 0)
+    return -EBADF;
+
+  if ((flags = fcntl(mouse->fd, F_GETFL)) == -1)
+    return -errno;
+
+  /* spinning needs non-blocking reads, blocking is then done with poll */
+  flags = max_budget > 0 ? flags | O_NONBLOCK : flags & ~O_NONBLOCK;
+  if (fcntl(mouse->fd, F_SETFL, flags) == -1)
+    return -errno;
+
+  mouse->busy.max_budget = max_budget;
+  mouse->busy.active = 0;
+  mouse->busy.period = 0;
+
+  return 0;
+}
+
+ssize_t busy_poll_read(struct spacemouse *mouse, void *buf, size_t size)
+{
+  struct spacemouse_stats *stats = &mouse->stats;
+  struct timespec start;
+  struct pollfd pfd;
+  ssize_t bytes;
+  long spun, budget;
+  int tries = 0;
+
+  /* spin while motion is active, for a bit longer than the usual gap
+   * between reports */
+  budget = mouse->busy.period + mouse->busy.period / 4;
+  if (budget > (long)mouse->busy.max_budget)
+    budget = mouse->busy.max_budget;
+  stats->busy_poll_budget = budget;
+
+  if (mouse->busy.active && budget > 0) {
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    do {
+      bytes = read(mouse->fd, buf, size);
+      stats->reads++;
+      spun = elapsed_us(&start);
+
+      if (bytes >= 0 || (errno != EAGAIN && errno != EINTR)) {
+        stats->busy_poll_spin += spun;
+        /* input that was already pending is not a hit */
+        if (bytes > 0 && tries > 0)
+          stats->busy_poll_hits++;
+        return bytes;
+      }
+      tries++;
+    } while (spun < budget);
+
+    stats->busy_poll_spin += spun;
+    stats->busy_poll_misses++;
+    mouse->busy.active = 0;
+  }
+
+  pfd.fd = mouse->fd;
+  pfd.events = POLLIN;
+
+  for (;;) {
+    bytes = read(mouse->fd, buf, size);
+    stats->reads++;
+
+    if (bytes >= 0 || (errno != EAGAIN && errno != EINTR))
+      return bytes;
+
+    if (poll(&pfd, 1, -1) == -1 && errno != EINTR)
+      return -1;
+  }
+}
+
+void busy_poll_frame(struct spacemouse *mouse, spacemouse_event_t const *event,
+                     struct timeval const *prev_time)
+{
+  struct spacemouse_event_motion const *motion = &event->motion;
+  long gap;
+
+  if (event->type != SPACEMOUSE_EVENT_MOTION)
+    return;
+
+  /* the device reports all zero axes when it is let go */
+  mouse->busy.active = motion->x || motion->y || motion->z ||
+                       motion->rx || motion->ry || motion->rz;
+
+  if (prev_time->tv_sec == 0)
+    return;
+
+  gap = (mouse->buf.time.tv_sec - prev_time->tv_sec) * 1000000L +
+        (mouse->buf.time.tv_usec - prev_time->tv_usec);
+
+  /* ignore the gap after an idle period */
+  if (gap <= 0 || gap > (long)mouse->busy.max_budget * 4)
+    return;
+
+  mouse->busy.period = mouse->busy.period == 0
+                         ? gap : (7 * mouse->busy.period + gap) / 8;
+}
@@ -0,0 +1,224 @@
+/*
+Copyright (c) 2013 Rolf Morel
+
+libspacemouse - a free software driver for 3D/6DoF input devices.
+
+libspacemouse is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+libspacemouse is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libspacemouse.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "libspacemouse.h"
+#include "types.h"
+#include "internal.h"
+
+/* frames per estimation window */
+#define CALIB_WINDOW 50
+/* a window is at rest when the variance of every axis is below this */
+#define CALIB_MAX_VARIANCE (3.0 * 3.0)
+/* offsets larger than this are the device being held, not bias */
+#define CALIB_MAX_BIAS 40.0
+/* weight of a new window in the estimate */
+#define CALIB_GAIN 0.2
+
+#define KEY_LEN 300
+#define LINE_LEN 512
+
+static char *calib_file = NULL;
+
+int spacemouse_set_calibration_file(char const *path)
+{
+  char *copy = NULL;
+
+  if (path != NULL) {
+    if ((copy = malloc(strlen(path) + 1)) == NULL)
+      return -errno;
+    strcpy(copy, path);
+  }
+
+  free(calib_file);
+  calib_file = copy;
+
+  return 0;
+}
+
+/* Devices are keyed by "vendor:product:serial" in the cache file, devices
+ * without serial of the same model share an entry. */
+static int calib_key(struct spacemouse *mouse, char *key)
+{
+  if (strlen(mouse->serial) > KEY_LEN - 16)
+    return -1;
+
+  sprintf(key, "%04x:%04x:%s ", mouse->vendor_id, mouse->product_id,
+          mouse->serial);
+
+  return 0;
+}
+
+static void calib_load(struct spacemouse *mouse)
+{
+  char key[KEY_LEN], line[LINE_LEN];
+  double bias[6];
+  FILE *file;
+  int axis;
+
+  if (calib_file == NULL || calib_key(mouse, key) == -1 ||
+      (file = fopen(calib_file, "r")) == NULL)
+    return;
+
+  while (fgets(line, sizeof line, file) != NULL) {
+    if (strncmp(line, key, strlen(key)) != 0)
+      continue;
+
+    if (sscanf(line + strlen(key), "%lf %lf %lf %lf %lf %lf", &bias[0],
+               &bias[1], &bias[2], &bias[3], &bias[4], &bias[5]) == 6) {
+      for (axis = 0; axis < 6; axis++)
+        mouse->calib.bias[axis] = bias[axis];
+      mouse->calib.valid = 1;
+    }
+    break;
+  }
+
+  fclose(file);
+}
+
+int spacemouse_device_save_calibration(struct spacemouse *mouse)
+{
+  char key[KEY_LEN], line[LINE_LEN], *tmp;
+  double *bias = mouse->calib.bias;
+  FILE *old, *new;
+  int ret = 0;
+
+  if (calib_file == NULL || !mouse->calib.valid)
+    return -EINVAL;
+
+  if (calib_key(mouse, key) == -1)
+    return -ENAMETOOLONG;
+
+  if ((tmp = malloc(strlen(calib_file) + 5)) == NULL)
+    return -errno;
+  sprintf(tmp, "%s.tmp", calib_file);
+
+  if ((new = fopen(tmp, "w")) == NULL) {
+    ret = -errno;
+    free(tmp);
+    return ret;
+  }
+
+  /* copy the entries of other devices, then replace the file at once */
+  if ((old = fopen(calib_file, "r")) != NULL) {
+    while (fgets(line, sizeof line, old) != NULL)
+      if (strncmp(line, key, strlen(key)) != 0)
+        fputs(line, new);
+    fclose(old);
+  }
+
+  fprintf(new, "%s%.2f %.2f %.2f %.2f %.2f %.2f\n", key, bias[0], bias[1],
+          bias[2], bias[3], bias[4], bias[5]);
+
+  if (fclose(new) == EOF || rename(tmp, calib_file) == -1) {
+    ret = -errno;
+    remove(tmp);
+  }
+
+  free(tmp);
+
+  return ret;
+}
+
+int spacemouse_device_set_calibration(struct spacemouse *mouse, int enable)
+{
+  if (enable != 0 && enable != 1)
+    return -EINVAL;
+
+  memset(&mouse->calib, 0, sizeof mouse->calib);
+  mouse->calib.enabled = enable;
+
+  if (enable)
+    calib_load(mouse);
+
+  return 0;
+}
+
+int spacemouse_device_get_bias(struct spacemouse *mouse, double bias[6])
+{
+  int axis;
+
+  if (!mouse->calib.enabled)
+    return -EINVAL;
+
+  for (axis = 0; axis < 6; axis++)
+    bias[axis] = mouse->calib.bias[axis];
+
+  return mouse->calib.valid;
+}
+
+void calib_apply(struct spacemouse *mouse,
+                 struct spacemouse_event_motion *motion)
+{
+  double value;
+  int axis;
+
+  if (!mouse->calib.valid)
+    return;
+
+  for (axis = 0; axis < 6; axis++) {
+    value = (&motion->x)[axis] - mouse->calib.bias[axis];
+    (&motion->x)[axis] = (int)(value < 0 ? value - 0.5 : value + 0.5);
+  }
+}
+
+void calib_frame(struct spacemouse *mouse,
+                 struct spacemouse_event_motion *motion)
+{
+  struct spacemouse_calib *calib = &mouse->calib;
+  double value, delta;
+  int axis, rest = 1;
+
+  /* Welford's running mean and variance over the raw values */
+  calib->count++;
+  for (axis = 0; axis < 6; axis++) {
+    value = (&motion->x)[axis];
+    delta = value - calib->mean[axis];
+    calib->mean[axis] += delta / calib->count;
+    calib->m2[axis] += delta * (value - calib->mean[axis]);
+  }
+
+  if (calib->count == CALIB_WINDOW) {
+    for (axis = 0; axis < 6; axis++)
+      if (calib->m2[axis] / (CALIB_WINDOW - 1) > CALIB_MAX_VARIANCE ||
+          calib->mean[axis] > CALIB_MAX_BIAS ||
+          calib->mean[axis] < -CALIB_MAX_BIAS)
+        rest = 0;
+
+    if (rest) {
+      for (axis = 0; axis < 6; axis++)
+        calib->bias[axis] = calib->valid ?
+            calib->bias[axis] + CALIB_GAIN * (calib->mean[axis] -
+                                              calib->bias[axis]) :
+            calib->mean[axis];
+      calib->valid = 1;
+      mouse->stats.calibrations++;
+    }
+
+    calib->count = 0;
+    memset(calib->mean, 0, sizeof calib->mean);
+    memset(calib->m2, 0, sizeof calib->m2);
+  }
+
+  calib_apply(mouse, motion);
+}
@@ -21,15 +21,19 @@ along with libspacemouse.  If not, see <http://www.gnu.org/licenses/>.
 #include <string.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <poll.h>
 #include <sys/ioctl.h>
 #include <linux/input.h>
 
 #include "libspacemouse.h"
 #include "types.h"
+#include "internal.h"
 
 #define LONG_BITS (sizeof(long) * 8)
 #define NLONGS(x) (((x) + LONG_BITS - 1) / LONG_BITS)
 
+#define BATCH_READ_EVENTS 64
+
 #ifdef MAP_AXIS_SPACENAVD
 /* Map axis the same way spacenavd/libspnav does by default. */
 static const int map_axis[] = { 0, 2, 1, 3, 5, 4 };
@@ -40,91 +44,313 @@ int spacemouse_device_open(struct spacemouse *mouse)
 {
   int fd;
 
-  if ((fd = open(mouse->devnode, O_RDWR)) == -1) {
+  /* devices of a stream receiver are read from the pipe it writes to */
+  if (mouse->remote.pipe[0] > -1) {
+    if ((fd = stream_open_device(mouse)) < 0)
+      return fd;
+  } else if ((fd = open(mouse->devnode, O_RDWR)) == -1) {
      if ((fd = open(mouse->devnode, O_RDONLY)) == -1) {
       return -errno;
     }
   }
 
+  PROBE3(open, mouse->id, mouse->devnode, fd);
+
+  mouse->max_axis = 0;
+  mouse->batch_type = -1;
+  mouse->batch_error = 0;
+  mouse->busy.max_budget = 0;
+
   return (mouse->fd = fd);
 }
 
+int evdev_decode_event(struct spacemouse *mouse, struct input_event const *ev,
+                       spacemouse_event_t *event, int *type)
+{
+  int ret = -1, axis_idx, axis_code, invert = 1;
+
+  PROBE4(raw_event, mouse->id, ev->type, ev->code, ev->value);
+
+  switch (ev->type) {
+    case EV_REL:
+    case EV_ABS:
+      axis_code = (ev->type == EV_REL) ? REL_X : ABS_X;
+
+      *type = mouse->buf.motion.type = SPACEMOUSE_EVENT_MOTION;
+#ifndef MAP_AXIS_SPACENAVD
+      axis_idx = ev->code - axis_code;
+#else
+      axis_idx = map_axis[ev->code - axis_code];
+      invert = map_invert[ev->code - axis_code];
+#endif
+
+      (&mouse->buf.motion.x)[axis_idx] = invert * ev->value;
+      break;
+
+    case EV_KEY:
+      *type = event->type = SPACEMOUSE_EVENT_BUTTON;
+      event->button.bnum = ev->code - BTN_0;
+      event->button.press = ev->value;
+      break;
+
+    case EV_LED:
+      if (ev->code == LED_MISC) {
+        *type = event->type = SPACEMOUSE_EVENT_LED;
+        event->led.state = ev->value;
+      }
+      break;
+
+    case EV_SYN:
+      if (ev->code == SYN_DROPPED)
+        mouse->stats.syn_dropped++;
+
+      mouse->buf.frame_time = ev->time;
+
+      if (*type == SPACEMOUSE_EVENT_MOTION) {
+        memcpy(event, &mouse->buf.motion, sizeof *event);
+        if (mouse->calib.enabled)
+          calib_frame(mouse, &event->motion);
+        if (mouse->buf.time.tv_sec != 0)
+          event->motion.period = ((ev->time.tv_sec * 1000 +
+                                   ev->time.tv_usec / 1000) -
+                                  (mouse->buf.time.tv_sec * 1000 +
+                                   mouse->buf.time.tv_usec / 1000));
+
+        mouse->buf.time = ev->time;
+        mouse->buf.motion.type = 0;
+      } else if (*type != SPACEMOUSE_EVENT_BUTTON &&
+                 *type != SPACEMOUSE_EVENT_LED) {
+        ret = SPACEMOUSE_READ_IGNORE;
+        break;
+      }
+
+      ret = SPACEMOUSE_READ_SUCCESS;
+      break;
+
+    default:
+      ret = SPACEMOUSE_READ_IGNORE;
+      break;
+  }
+
+  if (ret == SPACEMOUSE_READ_IGNORE) {
+    mouse->stats.frames_ignored++;
+    PROBE2(ignore, mouse->id, ev->type);
+  }
+
+  return ret;
+}
+
+static ssize_t device_read(struct spacemouse *mouse, void *buf, size_t size)
+{
+  ssize_t bytes;
+
+  if (mouse->busy.max_budget > 0)
+    return busy_poll_read(mouse, buf, size);
+
+  do {
+    bytes = read(mouse->fd, buf, size);
+    mouse->stats.reads++;
+  } while (bytes == -1 && errno == EINTR);
+
+  return bytes;
+}
+
+/* Account a frame delivered to the caller, prev_time is the time of the
+ * motion frame before it. */
+static void frame_delivered(struct spacemouse *mouse,
+                            spacemouse_event_t const *event,
+                            struct timeval const *prev_time)
+{
+  unsigned long latency = stats_frame_delivered(mouse);
+
+  PROBE3(frame, mouse->id, event->type, latency);
+
+  if (mouse->broadcast != NULL)
+    broadcast_publish(mouse->broadcast, event);
+
+  if (mouse->busy.max_budget > 0)
+    busy_poll_frame(mouse, event, prev_time);
+}
+
 enum spacemouse_read_result spacemouse_device_read_event(
     struct spacemouse *mouse, spacemouse_event_t *event)
 {
   struct input_event ev;
+  struct timeval prev_time = mouse->buf.time;
   ssize_t bytes;
-  int ret = -1, type = -1, axis_idx, axis_code, invert = 1;
+  int ret = -1, type = -1;
 
   while (ret == -1) {
 
-    do {
-      bytes = read(mouse->fd, &ev, sizeof ev);
-    } while (bytes == -1 && errno == EINTR);
+    bytes = device_read(mouse, &ev, sizeof ev);
 
     if (bytes < sizeof ev || errno == ENODEV)
       return -errno;
 
-    switch (ev.type) {
-      case EV_REL:
-      case EV_ABS:
-        axis_code = (ev.type == EV_REL) ? REL_X : ABS_X;
+    mouse->stats.events_read++;
 
-        type = mouse->buf.motion.type = SPACEMOUSE_EVENT_MOTION;
-#ifndef MAP_AXIS_SPACENAVD
-        axis_idx = ev.code - axis_code;
-#else
-        axis_idx = map_axis[ev.code - axis_code];
-        invert = map_invert[ev.code - axis_code];
-#endif
+    ret = evdev_decode_event(mouse, &ev, event, &type);
+  }
 
-        (&mouse->buf.motion.x)[axis_idx] = invert * ev.value;
-        break;
+  if (ret == SPACEMOUSE_READ_SUCCESS)
+    frame_delivered(mouse, event, &prev_time);
 
-      case EV_KEY:
-        type = event->type = SPACEMOUSE_EVENT_BUTTON;
-        event->button.bnum = ev.code - BTN_0;
-        event->button.press = ev.value;
-        break;
+  return ret;
+}
 
-      case EV_LED:
-        if (ev.code == LED_MISC) {
-          type = event->type = SPACEMOUSE_EVENT_LED;
-          event->led.state = ev.value;
-        }
-        break;
+int spacemouse_device_read_events(struct spacemouse *mouse,
+                                  spacemouse_event_t *events, int max_events)
+{
+  struct input_event ev[BATCH_READ_EVENTS];
+  struct timeval prev_time;
+  struct pollfd pfd;
+  ssize_t bytes;
+  int n = 0, count, i, ret;
 
-      case EV_SYN:
-        if (type == SPACEMOUSE_EVENT_MOTION) {
-          memcpy(event, &mouse->buf.motion, sizeof *event);
-          if (mouse->buf.time.tv_sec != 0)
-            event->motion.period = ((ev.time.tv_sec * 1000 +
-                                     ev.time.tv_usec / 1000) -
-                                    (mouse->buf.time.tv_sec * 1000 +
-                                     mouse->buf.time.tv_usec / 1000));
-
-          mouse->buf.time = ev.time;
-          mouse->buf.motion.type = 0;
-        } else if (type != SPACEMOUSE_EVENT_BUTTON &&
-                   type != SPACEMOUSE_EVENT_LED) {
-          ret = SPACEMOUSE_READ_IGNORE;
-          break;
-        }
-
-        ret = SPACEMOUSE_READ_SUCCESS;
-        break;
+  if (max_events <= 0)
+    return -EINVAL;
 
-      default:
-        ret = SPACEMOUSE_READ_IGNORE;
-        break;
+  if ((ret = mouse->batch_error) != 0) {
+    mouse->batch_error = 0;
+    return ret;
+  }
+
+  pfd.fd = mouse->fd;
+  pfd.events = POLLIN;
+
+  while (n < max_events) {
+    /* block until there is an event, then only take input that is pending */
+    if (n > 0 && (poll(&pfd, 1, 0) != 1 || !(pfd.revents & POLLIN)))
+      break;
+
+    /* every frame ends with a SYN event, so reading no more events than
+     * frames left never decodes more frames than fit */
+    count = max_events - n;
+    if (count > BATCH_READ_EVENTS)
+      count = BATCH_READ_EVENTS;
+
+    bytes = device_read(mouse, ev, count * sizeof *ev);
+
+    if (bytes < (ssize_t)sizeof *ev) {
+      if (n == 0)
+        return -errno;
+      /* the events read are returned first */
+      mouse->batch_error = -errno;
+      break;
     }
 
+    count = bytes / sizeof *ev;
+    mouse->stats.events_read += count;
+
+    for (i = 0; i < count; i++) {
+      prev_time = mouse->buf.time;
+
+      ret = evdev_decode_event(mouse, &ev[i], &events[n], &mouse->batch_type);
+      if (ret == -1)
+        continue;
+
+      mouse->batch_type = -1;
+      if (ret == SPACEMOUSE_READ_SUCCESS)
+        frame_delivered(mouse, &events[n++], &prev_time);
+    }
   }
 
-  return ret;
+  return n;
 }
 
-int spacemouse_device_get_max_axis_deviation(struct spacemouse *mouse)
+int spacemouse_device_read_motion_soa(struct spacemouse *mouse,
+                                      struct spacemouse_motion_soa *soa,
+                                      int max_frames)
+{
+  struct input_event ev[BATCH_READ_EVENTS];
+  /* raw values of the frames of one read, a frame has at least one event */
+  int raw[6][BATCH_READ_EVENTS];
+  struct timeval prev_time;
+  struct pollfd pfd;
+  spacemouse_event_t event;
+  ssize_t bytes;
+  int n = 0, count, i, ret, max_axis, axis, staged;
+
+  if (max_frames <= 0)
+    return -EINVAL;
+
+  if ((max_axis = spacemouse_device_get_max_axis_deviation(mouse)) <= 0)
+    return max_axis < 0 ? max_axis : -EINVAL;
+
+  soa->other_count = 0;
+
+  if ((ret = mouse->batch_error) != 0) {
+    mouse->batch_error = 0;
+    return ret;
+  }
+
+  pfd.fd = mouse->fd;
+  pfd.events = POLLIN;
+
+  while (n + soa->other_count < max_frames) {
+    /* block until there is a frame, then only take input that is pending */
+    if (n + soa->other_count > 0 &&
+        (poll(&pfd, 1, 0) != 1 || !(pfd.revents & POLLIN)))
+      break;
+
+    /* every frame ends with a SYN event, so reading no more events than
+     * frames left never decodes more frames than fit */
+    count = max_frames - n - soa->other_count;
+    if (count > BATCH_READ_EVENTS)
+      count = BATCH_READ_EVENTS;
+
+    bytes = device_read(mouse, ev, count * sizeof *ev);
+
+    if (bytes < (ssize_t)sizeof *ev) {
+      if (n + soa->other_count == 0)
+        return -errno;
+      /* the frames read are returned first */
+      mouse->batch_error = -errno;
+      break;
+    }
+
+    count = bytes / sizeof *ev;
+    mouse->stats.events_read += count;
+    staged = 0;
+
+    for (i = 0; i < count; i++) {
+      prev_time = mouse->buf.time;
+
+      ret = evdev_decode_event(mouse, &ev[i], &event, &mouse->batch_type);
+      if (ret == -1)
+        continue;
+
+      mouse->batch_type = -1;
+      if (ret != SPACEMOUSE_READ_SUCCESS)
+        continue;
+
+      frame_delivered(mouse, &event, &prev_time);
+
+      if (event.type != SPACEMOUSE_EVENT_MOTION) {
+        if (soa->other != NULL)
+          soa->other[soa->other_count++] = event;
+        continue;
+      }
+
+      for (axis = 0; axis < 6; axis++)
+        raw[axis][staged] = (&event.motion.x)[axis];
+
+      if (soa->time != NULL)
+        soa->time[n + staged] = mouse->buf.frame_time.tv_sec +
+                                mouse->buf.frame_time.tv_usec / 1e6;
+      staged++;
+    }
+
+    for (axis = 0; axis < 6; axis++)
+      normalize_axis(soa->axis[axis] + n, raw[axis], staged,
+                     1.0f / max_axis);
+    n += staged;
+  }
+
+  return n;
+}
+
+static int query_max_axis_deviation(struct spacemouse *mouse)
 {
   unsigned long bits[NLONGS(EV_CNT)];
 
@@ -162,6 +388,18 @@ int spacemouse_device_get_max_axis_deviation(struct spacemouse *mouse)
   return -1;
 }
 
+int spacemouse_device_get_max_axis_deviation(struct spacemouse *mouse)
+{
+  if (mouse->remote.pipe[0] > -1)
+    return mouse->remote.max_axis > 0 ? mouse->remote.max_axis : -1;
+
+  /* the range does not change while the device is open */
+  if (mouse->max_axis <= 0)
+    mouse->max_axis = query_max_axis_deviation(mouse);
+
+  return mouse->max_axis;
+}
+
 int spacemouse_device_set_grab(struct spacemouse *mouse, int grab)
 {
   if (grab == 0 || grab == 1)
@@ -202,7 +440,11 @@ int spacemouse_device_close(struct spacemouse *mouse)
 {
   int ret = close(mouse->fd);
 
+  PROBE2(close, mouse->id, mouse->fd);
+
   mouse->fd = -1;
+  mouse->max_axis = 0;
+  mouse->busy.max_budget = 0;
 
   return ret == -1 ? -errno : ret;
 }
@@ -0,0 +1,113 @@
+/*
+Copyright (c) 2013 Rolf Morel
+
+libspacemouse - a free software driver for 3D/6DoF input devices.
+
+libspacemouse is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+libspacemouse is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libspacemouse.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "libspacemouse.h"
+#include "internal.h"
+
+struct device_id {
+  unsigned int vendor, product;
+};
+
+/* Must be kept sorted on vendor, then product. */
+static const struct device_id builtin_ids[] = {
+  { 0x046d, 0xc603 }, /* SpaceMouse Plus XT */
+  { 0x046d, 0xc605 }, /* CADman */
+  { 0x046d, 0xc606 }, /* SpaceMouse Classic */
+  { 0x046d, 0xc621 }, /* SpaceBall 5000 */
+  { 0x046d, 0xc623 }, /* SpaceTraveler */
+  { 0x046d, 0xc625 }, /* SpacePilot */
+  { 0x046d, 0xc626 }, /* SpaceNavigator */
+  { 0x046d, 0xc627 }, /* SpaceExplorer */
+  { 0x046d, 0xc628 }, /* SpaceNavigator for Notebooks */
+  { 0x046d, 0xc629 }, /* SpacePilot Pro */
+  { 0x046d, 0xc62b }, /* SpaceMouse Pro */
+  { 0x046d, 0xc640 }, /* NuLOOQ */
+  { 0x256f, 0xc62e }, /* SpaceMouse Wireless (cabled) */
+  { 0x256f, 0xc62f }, /* SpaceMouse Wireless (receiver) */
+  { 0x256f, 0xc631 }, /* SpaceMouse Pro Wireless (cabled) */
+  { 0x256f, 0xc632 }, /* SpaceMouse Pro Wireless (receiver) */
+  { 0x256f, 0xc633 }, /* SpaceMouse Enterprise */
+  { 0x256f, 0xc635 }, /* SpaceMouse Compact */
+  { 0x256f, 0xc636 }, /* SpaceMouse Module */
+  { 0x256f, 0xc652 }  /* Universal Receiver */
+};
+
+static struct device_id *user_ids = NULL;
+static size_t user_ids_len = 0;
+
+static int device_id_cmp(void const *a, void const *b)
+{
+  struct device_id const *id_a = a, *id_b = b;
+
+  if (id_a->vendor != id_b->vendor)
+    return id_a->vendor < id_b->vendor ? -1 : 1;
+  if (id_a->product != id_b->product)
+    return id_a->product < id_b->product ? -1 : 1;
+  return 0;
+}
+
+int device_id_match(unsigned int vendor_id, unsigned int product_id)
+{
+  struct device_id key;
+
+  key.vendor = vendor_id;
+  key.product = product_id;
+
+  if (bsearch(&key, builtin_ids, sizeof builtin_ids / sizeof *builtin_ids,
+              sizeof *builtin_ids, device_id_cmp) != NULL)
+    return 1;
+
+  return user_ids_len > 0 &&
+         bsearch(&key, user_ids, user_ids_len, sizeof *user_ids,
+                 device_id_cmp) != NULL;
+}
+
+int spacemouse_device_id_add(unsigned int vendor_id, unsigned int product_id)
+{
+  struct device_id *ids;
+  size_t idx;
+
+  if (vendor_id > 0xffff || product_id > 0xffff)
+    return -EINVAL;
+
+  if (device_id_match(vendor_id, product_id))
+    return 0;
+
+  if ((ids = realloc(user_ids, (user_ids_len + 1) * sizeof *ids)) == NULL)
+    return -errno;
+  user_ids = ids;
+
+  /* insert in place to keep the table sorted */
+  for (idx = user_ids_len; idx > 0; idx--) {
+    if (user_ids[idx - 1].vendor < vendor_id ||
+        (user_ids[idx - 1].vendor == vendor_id &&
+         user_ids[idx - 1].product < product_id))
+      break;
+    user_ids[idx] = user_ids[idx - 1];
+  }
+  user_ids[idx].vendor = vendor_id;
+  user_ids[idx].product = product_id;
+  user_ids_len++;
+
+  return 0;
+}
@@ -0,0 +1,473 @@
+/*
+Copyright (c) 2013 Rolf Morel
+
+libspacemouse - a free software driver for 3D/6DoF input devices.
+
+libspacemouse is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+libspacemouse is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libspacemouse.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <errno.h>
+
+#include "libspacemouse.h"
+#include "types.h"
+#include "internal.h"
+
+#ifdef SPACEMOUSE_IO_URING
+
+#include <stdlib.h>
+#include <poll.h>
+#include <sys/uio.h>
+
+#include <liburing.h>
+
+/* Number of input_events read per submission, a full 6DoF report plus SYN is
+ * 7 events so this holds several reports. */
+#define URING_EVENTS 64
+
+#define MONITOR_DATA ((__u64)-2)
+#define CANCEL_DATA ((__u64)-1)
+
+enum slot_state {
+  SLOT_FREE,
+  SLOT_ARMED,      /* read posted, waiting for completion */
+  SLOT_PENDING,    /* read completed, buffer not yet fully decoded */
+  SLOT_CANCELLED,  /* device removed, waiting for kernel to release buffer */
+  SLOT_ERROR,      /* read failed, not yet reported to the caller */
+  SLOT_FAILED      /* read failed and reported, waiting for removal */
+};
+
+struct uring_slot {
+  struct spacemouse *mouse;
+  enum slot_state state;
+
+  spacemouse_event_t event;
+  int type;
+
+  int pos, count;
+
+  int coalesce_idx;
+
+  int error;
+};
+
+static struct io_uring ring;
+static int ring_open = 0;
+
+static struct uring_slot *slots = NULL;
+static struct input_event (*bufs)[URING_EVENTS] = NULL;
+static unsigned int nslots = 0;
+
+static int monitor_fd = -1;
+
+static struct io_uring_sqe *get_sqe(void)
+{
+  struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+
+  /* submission queue is full, flush it and try again */
+  if (sqe == NULL && io_uring_submit(&ring) >= 0)
+    sqe = io_uring_get_sqe(&ring);
+
+  return sqe;
+}
+
+static int arm_slot(unsigned int idx)
+{
+  struct io_uring_sqe *sqe;
+
+  if ((sqe = get_sqe()) == NULL)
+    return -EBUSY;
+
+  io_uring_prep_read_fixed(sqe, slots[idx].mouse->fd, bufs[idx],
+                           sizeof bufs[idx], (__u64)-1, idx);
+  io_uring_sqe_set_data64(sqe, idx + 1);
+
+  slots[idx].state = SLOT_ARMED;
+  slots[idx].pos = slots[idx].count = 0;
+
+  return 0;
+}
+
+int spacemouse_uring_open(unsigned int max_devices)
+{
+  struct iovec *iov;
+  unsigned int i;
+  int ret;
+
+  if (ring_open)
+    return ring.ring_fd;
+
+  if (max_devices == 0)
+    return -EINVAL;
+
+  slots = calloc(max_devices, sizeof *slots);
+  bufs = calloc(max_devices, sizeof *bufs);
+  iov = malloc(max_devices * sizeof *iov);
+  if (slots == NULL || bufs == NULL || iov == NULL) {
+    free(slots); free(bufs); free(iov); return -ENOMEM;
+  }
+
+  /* one read per device, one multishot poll for the monitor and room for
+   * cancellations */
+  if ((ret = io_uring_queue_init(2 * max_devices + 2, &ring, 0)) < 0) {
+    free(slots); free(bufs); free(iov); return ret;
+  }
+
+  for (i = 0; i < max_devices; i++) {
+    iov[i].iov_base = bufs[i];
+    iov[i].iov_len = sizeof bufs[i];
+  }
+
+  ret = io_uring_register_buffers(&ring, iov, max_devices);
+  free(iov);
+  if (ret < 0) {
+    io_uring_queue_exit(&ring); free(slots); free(bufs); return ret;
+  }
+
+  nslots = max_devices;
+  ring_open = 1;
+
+  return ring.ring_fd;
+}
+
+int spacemouse_uring_add_device(struct spacemouse *mouse)
+{
+  unsigned int i;
+  int ret;
+
+  if (!ring_open)
+    return -EBADF;
+
+  if (mouse->fd < 0)
+    return -EBADF;
+
+  for (i = 0; i < nslots; i++)
+    if (slots[i].state != SLOT_FREE && slots[i].mouse == mouse)
+      return -EEXIST;
+
+  for (i = 0; i < nslots; i++)
+    if (slots[i].state == SLOT_FREE)
+      break;
+
+  if (i == nslots)
+    return -ENOSPC;
+
+  slots[i].mouse = mouse;
+  slots[i].type = -1;
+
+  if ((ret = arm_slot(i)) < 0) {
+    slots[i].state = SLOT_FREE;
+    return ret;
+  }
+
+  ret = io_uring_submit(&ring);
+
+  return ret < 0 ? ret : 0;
+}
+
+int spacemouse_uring_remove_device(struct spacemouse *mouse)
+{
+  struct io_uring_sqe *sqe;
+  unsigned int i;
+  int ret;
+
+  if (!ring_open)
+    return -EBADF;
+
+  for (i = 0; i < nslots; i++) {
+    if (slots[i].state == SLOT_FREE || slots[i].mouse != mouse)
+      continue;
+
+    /* no read is posted */
+    if (slots[i].state == SLOT_PENDING || slots[i].state == SLOT_ERROR ||
+        slots[i].state == SLOT_FAILED) {
+      slots[i].mouse = NULL;
+      slots[i].state = SLOT_FREE;
+      return 0;
+    }
+
+    /* the read stays armed for the device, the caller can retry */
+    if ((sqe = get_sqe()) == NULL)
+      return -EBUSY;
+
+    io_uring_prep_cancel64(sqe, i + 1, 0);
+    io_uring_sqe_set_data64(sqe, CANCEL_DATA);
+
+    /* the buffer is registered with the kernel until the read completes,
+     * so the slot can only be reused once the cancellation is reaped */
+    slots[i].mouse = NULL;
+    slots[i].state = SLOT_CANCELLED;
+
+    ret = io_uring_submit(&ring);
+
+    return ret < 0 ? ret : 0;
+  }
+
+  return -ENOENT;
+}
+
+static int arm_monitor(void)
+{
+  struct io_uring_sqe *sqe;
+
+  if ((sqe = get_sqe()) == NULL)
+    return -EBUSY;
+
+  io_uring_prep_poll_multishot(sqe, monitor_fd, POLLIN);
+  io_uring_sqe_set_data64(sqe, MONITOR_DATA);
+
+  return 0;
+}
+
+int spacemouse_uring_add_monitor(int fd)
+{
+  int ret;
+
+  if (!ring_open)
+    return -EBADF;
+
+  monitor_fd = fd;
+
+  if ((ret = arm_monitor()) < 0)
+    return ret;
+
+  ret = io_uring_submit(&ring);
+
+  return ret < 0 ? ret : 0;
+}
+
+/* The read of a slot failed, it is reported by report_errors() and the slot
+ * stays in use until the device is removed. */
+static void fail_slot(unsigned int idx, int error)
+{
+  slots[idx].state = SLOT_ERROR;
+  slots[idx].error = error;
+}
+
+/* Report failed slots as events, returns the new number of filled entries. */
+static int report_errors(struct spacemouse_uring_event *events, int n,
+                         int max_events)
+{
+  unsigned int i;
+
+  for (i = 0; i < nslots && n < max_events; i++) {
+    if (slots[i].state != SLOT_ERROR)
+      continue;
+
+    events[n].mouse = slots[i].mouse;
+    events[n].event.type = 0;
+    events[n++].error = slots[i].error;
+    slots[i].state = SLOT_FAILED;
+  }
+
+  return n;
+}
+
+/* Decode buffered input_events of a slot into events, returns the new number
+ * of filled entries. Consecutive motion frames of the same device within one
+ * harvest are coalesced into the latest one. */
+static int drain_slot(unsigned int idx, struct spacemouse_uring_event *events,
+                      int n, int max_events)
+{
+  struct uring_slot *slot = &slots[idx];
+  int ret;
+
+  while (slot->pos < slot->count && n < max_events) {
+    ret = evdev_decode_event(slot->mouse, &bufs[idx][slot->pos++],
+                             &slot->event, &slot->type);
+    if (ret == -1)
+      continue;
+
+    slot->type = -1;
+
+    if (ret != SPACEMOUSE_READ_SUCCESS)
+      continue;
+
+    /* subscribers get every frame, also those coalesced below */
+    if (slot->mouse->broadcast != NULL)
+      broadcast_publish(slot->mouse->broadcast, &slot->event);
+
+    if (slot->event.type == SPACEMOUSE_EVENT_MOTION &&
+        slot->coalesce_idx > -1) {
+      spacemouse_event_t *prev = &events[slot->coalesce_idx].event;
+
+      slot->event.motion.period += prev->motion.period;
+      *prev = slot->event;
+      slot->mouse->stats.frames_coalesced++;
+      continue;
+    }
+
+    {
+      unsigned long latency = stats_frame_delivered(slot->mouse);
+
+      PROBE3(frame, slot->mouse->id, slot->event.type, latency);
+    }
+
+    events[n].mouse = slot->mouse;
+    events[n].event = slot->event;
+    events[n].error = 0;
+
+    slot->coalesce_idx =
+      slot->event.type == SPACEMOUSE_EVENT_MOTION ? n : -1;
+    n++;
+  }
+
+  if (slot->pos == slot->count && (ret = arm_slot(idx)) < 0)
+    fail_slot(idx, ret);
+
+  return n;
+}
+
+int spacemouse_uring_read_events(struct spacemouse_uring_event *events,
+                                 int max_events, int wait)
+{
+  struct io_uring_cqe *cqe;
+  unsigned int i;
+  int n = 0, monitor_reported = 0, ret;
+
+  if (!ring_open)
+    return -EBADF;
+
+  if (max_events <= 0)
+    return -EINVAL;
+
+  for (i = 0; i < nslots; i++)
+    slots[i].coalesce_idx = -1;
+
+  /* first finish buffers left over from a previous, full, harvest */
+  for (i = 0; i < nslots && n < max_events; i++)
+    if (slots[i].state == SLOT_PENDING)
+      n = drain_slot(i, events, n, max_events);
+
+  n = report_errors(events, n, max_events);
+
+  do {
+    if (n == 0 && wait)
+      ret = io_uring_submit_and_wait(&ring, 1);
+    else
+      ret = io_uring_submit(&ring);
+
+    if (ret < 0 && ret != -EINTR)
+      return ret;
+
+    while (n < max_events && io_uring_peek_cqe(&ring, &cqe) == 0) {
+      __u64 data = io_uring_cqe_get_data64(cqe);
+      int res = cqe->res;
+      unsigned int flags = cqe->flags;
+
+      io_uring_cqe_seen(&ring, cqe);
+
+      if (data == CANCEL_DATA)
+        continue;
+
+      if (data == MONITOR_DATA) {
+        if (!(flags & IORING_CQE_F_MORE) && arm_monitor() < 0)
+          return -EBUSY;
+        if (!monitor_reported) {
+          events[n].mouse = NULL;
+          events[n].event.type = 0;
+          events[n++].error = 0;
+          monitor_reported = 1;
+        }
+        continue;
+      }
+
+      i = (unsigned int)(data - 1);
+      if (i >= nslots)
+        continue;
+
+      if (slots[i].state == SLOT_CANCELLED) {
+        slots[i].state = SLOT_FREE;
+        continue;
+      }
+
+      if (res == -EINTR || res == -EAGAIN) {
+        if ((ret = arm_slot(i)) < 0)
+          fail_slot(i, ret);
+        continue;
+      }
+
+      /* e.g. -ENODEV when the device is gone, end of file is no better */
+      if (res <= 0) {
+        fail_slot(i, res < 0 ? res : -ENODEV);
+        continue;
+      }
+
+      slots[i].state = SLOT_PENDING;
+      slots[i].pos = 0;
+      slots[i].count = res / sizeof(struct input_event);
+
+      slots[i].mouse->stats.reads++;
+      slots[i].mouse->stats.events_read += slots[i].count;
+
+      n = drain_slot(i, events, n, max_events);
+    }
+
+    n = report_errors(events, n, max_events);
+  } while (n == 0 && wait);
+
+  io_uring_submit(&ring);
+
+  return n;
+}
+
+int spacemouse_uring_close(void)
+{
+  if (!ring_open)
+    return -EBADF;
+
+  io_uring_queue_exit(&ring);
+
+  free(slots); free(bufs);
+  slots = NULL; bufs = NULL;
+  nslots = 0;
+  monitor_fd = -1;
+  ring_open = 0;
+
+  return 0;
+}
+
+#else
+
+int spacemouse_uring_open(unsigned int max_devices)
+{
+  return -ENOSYS;
+}
+
+int spacemouse_uring_add_device(struct spacemouse *mouse)
+{
+  return -ENOSYS;
+}
+
+int spacemouse_uring_remove_device(struct spacemouse *mouse)
+{
+  return -ENOSYS;
+}
+
+int spacemouse_uring_add_monitor(int monitor_fd)
+{
+  return -ENOSYS;
+}
+
+int spacemouse_uring_read_events(struct spacemouse_uring_event *events,
+                                 int max_events, int wait)
+{
+  return -ENOSYS;
+}
+
+int spacemouse_uring_close(void)
+{
+  return -ENOSYS;
+}
+
+#endif
@@ -0,0 +1,140 @@
+/*
+Copyright (c) 2013 Rolf Morel
+
+libspacemouse - a free software driver for 3D/6DoF input devices.
+
+libspacemouse is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+libspacemouse is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libspacemouse.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _INTERNAL_H_
+#define _INTERNAL_H_
+
+#include <linux/input.h>
+
+#include "libspacemouse.h"
+#include "types.h"
+
+/* Static tracepoints, built in with USDT=1. The probes are nops until a
+ * tracer (bpftrace, perf, systemtap) attaches to them. */
+#ifdef SPACEMOUSE_USDT
+#include <sys/sdt.h>
+#define PROBE1(name, a) DTRACE_PROBE1(libspacemouse, name, a)
+#define PROBE2(name, a, b) DTRACE_PROBE2(libspacemouse, name, a, b)
+#define PROBE3(name, a, b, c) DTRACE_PROBE3(libspacemouse, name, a, b, c)
+#define PROBE4(name, a, b, c, d) DTRACE_PROBE4(libspacemouse, name, a, b, c, d)
+#else
+#define PROBE1(name, a) do { (void)(a); } while (0)
+#define PROBE2(name, a, b) do { (void)(a); (void)(b); } while (0)
+#define PROBE3(name, a, b, c) \
+  do { (void)(a); (void)(b); (void)(c); } while (0)
+#define PROBE4(name, a, b, c, d) \
+  do { (void)(a); (void)(b); (void)(c); (void)(d); } while (0)
+#endif
+
+/* Feed one raw evdev event into the device's decode state.
+ *
+ * type holds the frame state between calls and must be initialized to -1 at
+ * the start of a frame. Returns -1 while the frame is incomplete, otherwise
+ * one of SPACEMOUSE_READ_*, after which type should be reset to -1. */
+int evdev_decode_event(struct spacemouse *mouse, struct input_event const *ev,
+                       spacemouse_event_t *event, int *type);
+
+/* Device list, shared by the enumeration and monitor backends. */
+struct spacemouse *devnode_used_in_list(char const *devnode);
+struct spacemouse *add_device(char const *devnode,
+                              unsigned int vendor_id,
+                              unsigned int product_id,
+                              char const *manufacturer,
+                              char const *product,
+                              char const *serial);
+void remove_device(struct spacemouse *mouse, int list_only);
+
+/* Unlink a device from the list and keep it as the cached device, which is
+ * valid until the next removal. Returns the cached device. */
+struct spacemouse *remove_device_cached(struct spacemouse *mouse);
+
+/* Seat and tag filter, NULL when not set. */
+char const *list_get_seat(void);
+char const *list_get_tag(void);
+
+/* Returns 1 when a device on seat, NULL for no ID_SEAT, passes the filter. */
+int list_seat_match(char const *seat);
+
+#ifndef SPACEMOUSE_NO_UDEV
+int udev_backend_device_list(void);
+int udev_backend_monitor_open(void);
+enum spacemouse_action udev_backend_monitor(struct spacemouse **mouse_ptr);
+int udev_backend_monitor_close(void);
+#endif
+
+int sysfs_backend_device_list(void);
+char const *sysfs_get_sysroot(void);
+
+/* Add the event device at syspath when it is supported and not yet listed.
+ * Returns NULL with errno set to 0 when the device is skipped. */
+struct spacemouse *sysfs_add_device(char const *syspath);
+
+int kernel_backend_monitor_open(void);
+int kernel_backend_monitor_open_fd(int fd);
+enum spacemouse_action kernel_backend_monitor(struct spacemouse **mouse_ptr);
+int kernel_backend_monitor_close(void);
+
+/* Size of the ring's allocation in bytes. */
+size_t broadcast_ring_bytes(struct broadcast_ring *ring);
+
+/* Publish a delivered event to the device's subscribers. */
+void broadcast_publish(struct broadcast_ring *ring,
+                       spacemouse_event_t const *event);
+
+/* Convert n values to floats multiplied by scale and clamped to [-1, 1],
+ * using the widest SIMD kernel the cpu supports. dst and src must not
+ * overlap. */
+void normalize_axis(float *dst, int const *src, int n, float scale);
+
+/* Read from the device with busy-polling, see
+ * spacemouse_device_set_busy_poll(). Blocks like read() would on a blocking
+ * file descriptor. */
+ssize_t busy_poll_read(struct spacemouse *mouse, void *buf, size_t size);
+
+/* Update the busy-poll state with a delivered frame, prev_time is the time of
+ * the motion frame before it. */
+void busy_poll_frame(struct spacemouse *mouse, spacemouse_event_t const *event,
+                     struct timeval const *prev_time);
+
+/* Open and probe all devices of the list which are not open, concurrently,
+ * see SPACEMOUSE_LIST_PROBE. */
+int probe_devices(struct spacemouse *head);
+
+/* Update the bias estimate with a motion frame and subtract the bias, see
+ * spacemouse_device_set_calibration(). */
+void calib_frame(struct spacemouse *mouse,
+                 struct spacemouse_event_motion *motion);
+
+/* Only subtract the current bias estimate. */
+void calib_apply(struct spacemouse *mouse,
+                 struct spacemouse_event_motion *motion);
+
+/* Returns 1 when vendor_id:product_id is in the built-in or user added table
+ * of supported devices. */
+int device_id_match(unsigned int vendor_id, unsigned int product_id);
+
+/* Account a frame delivered to the caller in the device's counters, returns
+ * the frame's latency in microseconds. */
+unsigned long stats_frame_delivered(struct spacemouse *mouse);
+
+/* Open a remote device of the stream receiver, returns a blocking file
+ * descriptor of its pipe or negative errno. */
+int stream_open_device(struct spacemouse *mouse);
+
+#endif
@@ -22,6 +22,8 @@ along with libspacemouse.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef _LIBSPACEMOUSE_H_
 #define _LIBSPACEMOUSE_H_
 
+struct timespec;
+
 enum spacemouse_event_type {
   SPACEMOUSE_EVENT_MOTION = 1,
   SPACEMOUSE_EVENT_BUTTON = 2,
@@ -39,6 +41,21 @@ enum spacemouse_read_result {
   SPACEMOUSE_READ_SUCCESS
 };
 
+/**
+ * Flags of spacemouse_device_list().
+ */
+enum spacemouse_list_flags {
+  /** Initialize/update the device list. */
+  SPACEMOUSE_LIST_UPDATE = 1,
+  /** Open and probe the devices which are not open yet, concurrently. */
+  SPACEMOUSE_LIST_PROBE = 2
+};
+
+enum spacemouse_backend {
+  SPACEMOUSE_BACKEND_UDEV,
+  SPACEMOUSE_BACKEND_KERNEL
+};
+
 struct spacemouse_event_motion {
   int type;
   int x, y, z;
@@ -64,15 +81,219 @@ typedef union spacemouse_event {
   struct spacemouse_event_led led;
 } spacemouse_event_t;
 
+/**
+ * Number of buckets in the latency histogram of struct spacemouse_stats.
+ */
+#define SPACEMOUSE_LATENCY_BUCKETS 16
+
+/**
+ * Performance counters of a device.
+ *
+ * Latencies are the time in microseconds between the kernel timestamping a
+ * report and the report being delivered by the library.
+ */
+struct spacemouse_stats {
+  unsigned long events_read;      /**< raw input events read */
+  unsigned long reads;            /**< read syscalls issued */
+  unsigned long frames;           /**< frames delivered */
+  unsigned long frames_ignored;   /**< frames without useful data */
+  unsigned long frames_coalesced; /**< motion frames merged into a later one */
+  unsigned long syn_dropped;      /**< kernel buffer overruns (SYN_DROPPED) */
+
+  unsigned long latency_min;
+  unsigned long latency_avg;
+  unsigned long latency_max;
+  /** Bucket 0 counts latencies below 2us, bucket i latencies in
+   * [2^i, 2^(i+1)) us and the last bucket all larger latencies. */
+  unsigned long latency_hist[SPACEMOUSE_LATENCY_BUCKETS];
+
+  unsigned long samples;           /**< ticks emitted in sampling mode */
+  unsigned long sample_overruns;   /**< ticks missed in sampling mode */
+  unsigned long sample_jitter_avg; /**< tick wakeup delay in us */
+  unsigned long sample_jitter_max;
+
+  unsigned long busy_poll_hits;    /**< reports caught while spinning */
+  unsigned long busy_poll_misses;  /**< spins which ran out of budget */
+  unsigned long busy_poll_spin;    /**< total time spent spinning in us */
+  unsigned long busy_poll_budget;  /**< current spin budget in us */
+
+  unsigned long calibrations;      /**< at rest windows in the bias estimate */
+};
+
+/**
+ * Result of probing a device, see SPACEMOUSE_LIST_PROBE.
+ */
+struct spacemouse_probe {
+  int error;             /**< 0 or negative errno of the failed step */
+  int max_axis;          /**< see spacemouse_device_get_max_axis_deviation() */
+  int led;               /**< LED state at the time of the probe */
+  unsigned long buttons; /**< bit n is set when button n was pressed */
+  unsigned long time;    /**< time taken to probe the device in us */
+};
+
+/**
+ * Caller provided structure-of-arrays buffers for
+ * spacemouse_device_read_motion_soa().
+ */
+struct spacemouse_motion_soa {
+  /** One array per axis, in the order x, y, z, rx, ry, rz. */
+  float *axis[6];
+  /** Kernel timestamp of each frame in seconds, may be NULL. */
+  double *time;
+  /** Button and led events, in the order read, or NULL to drop them. */
+  spacemouse_event_t *other;
+  /** Set to the number of events stored in other. */
+  int other_count;
+};
+
+/**
+ * Counters of the stream publisher and receiver, see spacemouse_stream_open()
+ * and spacemouse_stream_receiver_open().
+ */
+struct spacemouse_stream_stats {
+  unsigned long packets_sent;      /**< datagrams sent by the publisher */
+  unsigned long send_errors;       /**< datagrams refused by the network */
+  unsigned long records_sent;      /**< events sent */
+  unsigned long records_coalesced; /**< motion events merged into a later one */
+
+  unsigned long packets_received;  /**< valid datagrams received */
+  unsigned long packets_lost;      /**< gaps in the sequence numbers */
+  unsigned long packets_reordered; /**< datagrams after a newer one */
+  unsigned long packets_duplicate; /**< datagrams received twice */
+  unsigned long records_received;  /**< events passed to remote devices */
+  unsigned long records_dropped;   /**< events of remote devices not read */
+  unsigned long invalid;           /**< malformed datagrams and events */
+};
+
+/**
+ * Options of a library managed reader thread, see spacemouse_reader_start().
+ */
+struct spacemouse_reader_config {
+  /** CPUs the reader is pinned to, ncpus 0 leaves the affinity as is. */
+  int const *cpus;
+  int ncpus;
+  /** SCHED_FIFO priority (1-99), 0 keeps the default scheduling policy. */
+  int priority;
+  /** Set to 1 to mlock the device and its broadcast ring. */
+  int lock_memory;
+};
+
 /**
  * Opaque structure representing a spacemouse device
  */
 struct spacemouse;
 
+/**
+ * Reader of a device's broadcast ring, see spacemouse_subscriber_init().
+ *
+ * Each subscriber is owned by a single thread.
+ */
+struct spacemouse_subscriber {
+  struct spacemouse *mouse;
+  unsigned long cursor;
+  /** Number of events this subscriber missed because it was lapped. */
+  unsigned long lost;
+};
+
+/**
+ * Event harvested by spacemouse_uring_read_events().
+ *
+ * When mouse is NULL the event signals that the monitor file descriptor is
+ * readable and spacemouse_monitor() should be called.
+ */
+struct spacemouse_uring_event {
+  struct spacemouse *mouse;
+  spacemouse_event_t event;
+  /** 0, or negative errno when reading mouse failed, e.g. -ENODEV when it
+   * was unplugged. The device is no longer read and event is not set. */
+  int error;
+};
+
+/**
+ * Event of one of the devices merged by spacemouse_merge_read_events().
+ */
+struct spacemouse_merge_event {
+  struct spacemouse *mouse;
+  int id;  /**< id of the device, see spacemouse_device_get_id() */
+  spacemouse_event_t event;
+  /** Kernel timestamp of the event in seconds. */
+  double time;
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * Select how devices are enumerated.
+ *
+ * UDEV (the default) enumerates and monitors devices through libudev. KERNEL
+ * scans /sys/class/input directly and listens to the kernel's uevents, which
+ * avoids starting libudev and works without the udev daemon, but does not
+ * filter by seat or tag, see spacemouse_set_seat().
+ *
+ * The backend for monitoring is fixed when spacemouse_monitor_open() is
+ * called.
+ *
+ * When the library is built with UDEV=0 only KERNEL is available, and is the
+ * default.
+ *
+ * @param backend One of SPACEMOUSE_BACKEND_*.
+ *
+ * @return 0 on success, or -ENOTSUP when the backend is not built in.
+ */
+int
+spacemouse_set_backend(enum spacemouse_backend backend);
+
+/**
+ * Set the root of the filesystem used by the KERNEL backend.
+ *
+ * sysfs is read from the sys directory, and device nodes are expected in the
+ * dev directory, of the root. This allows enumerating a fake sysfs tree.
+ *
+ * @param root Path of the root, or NULL to reset to the real root "/".
+ *
+ * @return 0 on success or negative errno on error.
+ */
+int
+spacemouse_set_sysroot(char const *root);
+
+/**
+ * Restrict the device list to the devices of a seat.
+ *
+ * Devices are assigned to a seat by the udev ID_SEAT property, devices
+ * without it belong to "seat0". Devices of other seats are skipped by
+ * spacemouse_device_list() and spacemouse_monitor() before they are added to
+ * the list.
+ *
+ * Only the UDEV backend filters: the KERNEL backend learns of a new device
+ * before udevd has assigned its seat, so spacemouse_device_list(),
+ * spacemouse_monitor_open() and spacemouse_monitor_open_fd() return -ENOTSUP
+ * on it while a seat or tag is set.
+ *
+ * @param seat Name of the seat, e.g. "seat1", or NULL to list the devices of
+ * all seats (the default).
+ *
+ * @return 0 on success or negative errno on error, -ENOTSUP when a seat is
+ * set while the KERNEL backend is used.
+ */
+int
+spacemouse_set_seat(char const *seat);
+
+/**
+ * Restrict the device list to devices carrying a udev tag.
+ *
+ * Like spacemouse_set_seat(), but by a tag set by udev rules, e.g. with
+ * TAG+="myapp". The monitor filters in the kernel.
+ *
+ * @param tag Name of the tag, or NULL to not filter on tags (the default).
+ *
+ * @return 0 on success or negative errno on error, -ENOTSUP when a tag is
+ * set while the KERNEL backend is used.
+ */
+int
+spacemouse_set_tag(char const *tag);
+
 /**
  * Get first device in list and initialize/update the internal device list.
  *
@@ -81,16 +302,44 @@ extern "C" {
  *
  * This functions should at least once be called with update argument set to 1.
  *
+ * With SPACEMOUSE_LIST_PROBE all devices in the list which are not open yet
+ * are opened at once, each from its own thread, and probed for their axis
+ * range, LED and button state. The current state of absolute axes is taken
+ * as the device's initial motion state. Devices which fail to open stay in
+ * the list closed, the error is returned by spacemouse_device_get_probe().
+ *
  * @param mouse_ptr Pointer pointer which will be set to point to the first
  * device in list on successfull return.
  * @param update Set to 0 to only return the current head of the device list,
- * or 1 to first initialize/update the device list.
+ * or 1 (SPACEMOUSE_LIST_UPDATE) to first initialize/update the device list,
+ * optionally or-ed with SPACEMOUSE_LIST_PROBE.
  *
  * @return 0 on success or negative errno on errro.
  */
 int
 spacemouse_device_list(struct spacemouse **mouse_ptr, int update);
 
+/**
+ * Get the result of probing a device with SPACEMOUSE_LIST_PROBE.
+ *
+ * @param mouse The device of which the probe result is to be returned.
+ * @param probe Filled with the result of the last probe of the device.
+ *
+ * @return 0 on success or -EINVAL when the device has not been probed.
+ */
+int
+spacemouse_device_get_probe(struct spacemouse *mouse,
+                            struct spacemouse_probe *probe);
+
+/**
+ * Get the time taken by the last SPACEMOUSE_LIST_PROBE, from the first device
+ * being opened until all devices are probed.
+ *
+ * @return The time in microseconds.
+ */
+unsigned long
+spacemouse_device_list_get_probe_time(void);
+
 /**
  * Returns next node in the device list.
  *
@@ -123,6 +372,25 @@ spacemouse_device_list_get_next(struct spacemouse *mouse);
 int
 spacemouse_monitor_open(void);
 
+/**
+ * Use a given socket as source of kernel uevent messages.
+ *
+ * The KERNEL backend monitor is used with fd instead of the kernel's uevent
+ * netlink socket, e.g. one end of a socketpair(AF_UNIX, SOCK_DGRAM) to which
+ * a test feeds uevent messages in the kernel's format:
+ * "ACTION@DEVPATH\0ACTION=...\0DEVPATH=...\0SUBSYSTEM=...\0DEVNAME=...\0".
+ *
+ * Added devices are looked up in sysfs below the root set with
+ * spacemouse_set_sysroot().
+ *
+ * @param fd File descriptor of a datagram socket, owned by the library from
+ * now on and closed by spacemouse_monitor_close().
+ *
+ * @return fd on success or negative errno on error.
+ */
+int
+spacemouse_monitor_open_fd(int fd);
+
 /**
  * Wrap system device manager connection.
  *
@@ -187,6 +455,61 @@ enum spacemouse_read_result
 spacemouse_device_read_event(struct spacemouse *mouse,
                              spacemouse_event_t *event);
 
+/**
+ * Read a batch of events.
+ *
+ * Like spacemouse_device_read_event(), but input is read in bulk, many events
+ * per syscall.
+ *
+ * Blocks until at least one event is read, then keeps reading as long as the
+ * device has input pending and the buffer has room. When a read fails after
+ * events were read, the events are returned and the error is returned by the
+ * next call.
+ *
+ * @param mouse The device to be read.
+ * @param[out] events Buffer of at least max_events events.
+ * @param max_events Maximum number of events to be read.
+ *
+ * @return Number of events stored at the front of events, or negative errno
+ * on error.
+ *
+ * @note Should not be mixed with spacemouse_device_read_event() on the same
+ * device.
+ */
+int
+spacemouse_device_read_events(struct spacemouse *mouse,
+                              spacemouse_event_t *events, int max_events);
+
+/**
+ * Read a batch of motion events into structure-of-arrays buffers.
+ *
+ * Axis values are normalized to [-1, 1] using the device's maximum axis
+ * deviation, with SIMD when available, so they can be consumed directly by
+ * vectorized code. Input is read in bulk, many events per syscall.
+ *
+ * Blocks until at least one event is stored, then keeps reading as long as
+ * the device has input pending and the buffers have room. Button and led
+ * events are stored in the other buffer, or dropped when it is NULL; either
+ * way they are published to subscribers. When a read fails after events were
+ * read, the events are returned and the error is returned by the next call.
+ *
+ * @param mouse The device to be read.
+ * @param soa Buffers, each at least max_frames elements long.
+ * @param max_frames Maximum number of motion, button and led events to be
+ * read together.
+ *
+ * @return Number of motion events stored at the front of the buffers, which
+ * may be 0 when only button or led events were read, or negative errno on
+ * error.
+ *
+ * @note Should not be mixed with spacemouse_device_read_event() on the same
+ * device.
+ */
+int
+spacemouse_device_read_motion_soa(struct spacemouse *mouse,
+                                  struct spacemouse_motion_soa *soa,
+                                  int max_frames);
+
 /**
  * Return unique id of device.
  *
@@ -214,6 +537,18 @@ spacemouse_device_get_id(struct spacemouse *mouse);
 int
 spacemouse_device_get_fd(struct spacemouse *mouse);
 
+/**
+ * Return the kernel timestamp of the last frame read from the device.
+ *
+ * @param mouse The device of which the frame time is to be returned.
+ *
+ * @return Seconds since the epoch, in the clock of evdev (CLOCK_REALTIME), of
+ * the event returned by the last spacemouse_device_read_event(), or 0 when
+ * nothing was read.
+ */
+double
+spacemouse_device_get_frame_time(struct spacemouse *mouse);
+
 /**
  * Return path of the device node of the device.
  *
@@ -256,9 +591,62 @@ spacemouse_device_get_manufacturer(struct spacemouse *mouse);
 char const * const
 spacemouse_device_get_product(struct spacemouse *mouse);
 
+/**
+ * Return serial number of the device.
+ *
+ * @param mouse The device of which the serial number is to be returned.
+ *
+ * @return The character string which holds the USB serial number of the device,
+ * empty when the device does not report one.
+ *
+ * @note The returned string is only valid as long as the device is still
+ * connected.
+ */
+char const * const
+spacemouse_device_get_serial(struct spacemouse *mouse);
+
+/**
+ * Return USB vendor id of the device.
+ *
+ * @param mouse The device of which the vendor id is to be returned.
+ *
+ * @return The device's vendor id, e.g. 0x256f for 3Dconnexion or 0x046d for
+ * Logitech.
+ */
+unsigned int
+spacemouse_device_get_vendor_id(struct spacemouse *mouse);
+
+/**
+ * Return USB product id of the device.
+ *
+ * @param mouse The device of which the product id is to be returned.
+ *
+ * @return The device's product id.
+ */
+unsigned int
+spacemouse_device_get_product_id(struct spacemouse *mouse);
+
+/**
+ * Add a device to the table of supported devices.
+ *
+ * Devices are recognized by their USB vendor and product id. A table of known
+ * 3Dconnexion devices, including those branded by Logitech, is built in. Use
+ * this function to support other devices, before calling
+ * spacemouse_device_list().
+ *
+ * @param vendor_id USB vendor id of the device.
+ * @param product_id USB product id of the device.
+ *
+ * @return 0 on success or negative errno on error.
+ */
+int
+spacemouse_device_id_add(unsigned int vendor_id, unsigned int product_id);
+
 /**
  * Return maximux deviation possible on a axis, valid for all axes of device.
  *
+ * The value is queried once after the device is opened and cached.
+ *
  * @param mouse The device of which the maximum deviation is to be returned.
  *
  * @return The maximum deviation for all axes of device, or -1 in case of
@@ -338,6 +726,572 @@ spacemouse_device_set_data(struct spacemouse *mouse, void *data);
 void *
 spacemouse_device_get_data(struct spacemouse *mouse);
 
+/**
+ * Retrieve the performance counters of a device.
+ *
+ * Counters are kept from the moment the device is added to the device list,
+ * or from the last call to spacemouse_device_reset_stats(mouse).
+ *
+ * @param mouse The device of which the counters are to be returned.
+ * @param[out] stats Structure which is set to the current counter values.
+ */
+void
+spacemouse_device_get_stats(struct spacemouse *mouse,
+                            struct spacemouse_stats *stats);
+
+/**
+ * Reset all performance counters of a device to zero.
+ *
+ * @param mouse The device of which the counters are to be reset.
+ */
+void
+spacemouse_device_reset_stats(struct spacemouse *mouse);
+
+/**
+ * Enable busy-polling of a device.
+ *
+ * Waking up from a blocking read adds scheduler latency. With busy-polling,
+ * while the device is in motion, spacemouse_device_read_event() spins on
+ * non-blocking reads for the next report, for a budget adapted to the
+ * observed gap between reports, capped at max_budget. When the budget runs
+ * out, or the device is let go, it falls back to a blocking wait.
+ *
+ * Only useful when the read functions are called directly, e.g. from a
+ * reader thread, not after select or poll. Spin time and hits are reported in
+ * the device's stats.
+ *
+ * @param mouse The device to be polled, it must be opened.
+ * @param max_budget Maximum time to spin in microseconds, 0 disables
+ * busy-polling.
+ *
+ * @return 0 on success or negative errno on error.
+ *
+ * @note Puts the device's file descriptor in non-blocking mode while enabled,
+ * so it should not be combined with the io_uring reader.
+ */
+int
+spacemouse_device_set_busy_poll(struct spacemouse *mouse,
+                                unsigned int max_budget);
+
+/**
+ * Enable automatic zero recalibration of a device.
+ *
+ * Aging devices report small offsets at rest. With calibration enabled the
+ * library estimates the offset of each axis from windows of motion frames in
+ * which the device is at rest, i.e. every axis varies by no more than a few
+ * units around a small value, and subtracts it from the motion events it
+ * delivers. The estimate follows slow drift.
+ *
+ * When a calibration file is set, see spacemouse_set_calibration_file(), the
+ * last saved bias of the device is loaded as the starting estimate.
+ *
+ * @param mouse The device to be calibrated.
+ * @param enable Set to 1 to enable and 0 to disable calibration. Both discard
+ * the current estimate.
+ *
+ * @return 0 on success or negative errno on error.
+ */
+int
+spacemouse_device_set_calibration(struct spacemouse *mouse, int enable);
+
+/**
+ * Get the current bias estimate of a device.
+ *
+ * @param mouse The device of which the bias is to be returned.
+ * @param bias Filled with the bias of each axis in raw units, in the order x,
+ * y, z, rx, ry, rz.
+ *
+ * @return 1 when the bias holds an estimate, 0 when the device has not been
+ * at rest yet or negative errno when calibration is not enabled.
+ */
+int
+spacemouse_device_get_bias(struct spacemouse *mouse, double bias[6]);
+
+/**
+ * Set the file in which device calibrations are cached.
+ *
+ * The file holds one line per device, keyed by vendor id, product id and
+ * serial number. Devices without serial number share the entry of their
+ * model.
+ *
+ * @param path Path of the cache file, or NULL to not use a cache file (the
+ * default).
+ *
+ * @return 0 on success or negative errno on error.
+ */
+int
+spacemouse_set_calibration_file(char const *path);
+
+/**
+ * Save the bias estimate of a device in the calibration file.
+ *
+ * @param mouse The device of which the bias is to be saved.
+ *
+ * @return 0 on success or negative errno on error, -EINVAL when there is no
+ * calibration file or no estimate.
+ *
+ * @note The file is replaced atomically, but concurrent saves from different
+ * processes may lose each other's entries.
+ */
+int
+spacemouse_device_save_calibration(struct spacemouse *mouse);
+
+/**
+ * Start fixed-rate sampling of a device.
+ *
+ * The library arms a timer at the given rate, on every tick
+ * spacemouse_device_sample() returns the device's current axis state as a
+ * motion event, giving a uniform stream of setpoints instead of reports on
+ * change only.
+ *
+ * The device must still be read with spacemouse_device_read_event() to keep
+ * the axis state up to date, i.e. both file descriptors belong in the same
+ * select/poll set.
+ *
+ * @param mouse The device to be sampled.
+ * @param rate Sampling rate in Hz, e.g. 500 or 1000.
+ *
+ * @return File descriptor of the timer, readable on every tick, or negative
+ * errno on error.
+ */
+int
+spacemouse_device_sampling_open(struct spacemouse *mouse, unsigned int rate);
+
+/**
+ * Emit the held axis state of a device for the current tick.
+ *
+ * When ticks were missed, e.g. because the caller was late, only the latest
+ * tick is emitted and the missed ticks are counted as overruns in the
+ * device's stats, together with the wakeup jitter.
+ *
+ * @param mouse The device being sampled.
+ * @param[out] event Set to a motion event holding the current axis state,
+ * with period set to the time in milliseconds since the previous tick.
+ * @param[out] tick_time When not NULL, set to the exact scheduled time of the
+ * tick on CLOCK_MONOTONIC.
+ *
+ * @return SUCCESS, or negative errno on error.
+ *
+ * @note Blocks until the next tick, use select, poll, etc.
+ */
+enum spacemouse_read_result
+spacemouse_device_sample(struct spacemouse *mouse, spacemouse_event_t *event,
+                         struct timespec *tick_time);
+
+/**
+ * Stop fixed-rate sampling of a device and close the timer.
+ *
+ * @param mouse The device being sampled.
+ *
+ * @return 0 on success, or negative errno on error.
+ */
+int
+spacemouse_device_sampling_close(struct spacemouse *mouse);
+
+/**
+ * Enable broadcasting of a device's events.
+ *
+ * Every event delivered by spacemouse_device_read_event(), or the io_uring
+ * reader, is also published into a ring of the given size, from which any
+ * number of subscribers, e.g. on other threads, read all events
+ * independently.
+ *
+ * The producer never waits for subscribers. A subscriber which falls more than
+ * size events behind skips to the oldest event still available, and counts the
+ * skipped events as lost.
+ *
+ * @param mouse The device of which events are to be broadcast.
+ * @param size Number of events held by the ring, must be a power of two.
+ *
+ * @return 0 on success or negative errno on error.
+ */
+int
+spacemouse_device_broadcast_enable(struct spacemouse *mouse,
+                                   unsigned int size);
+
+/**
+ * Disable broadcasting of a device's events.
+ *
+ * @param mouse The device of which the ring is to be freed.
+ *
+ * @return 0 on success, or -EBUSY while the device's reader thread runs, see
+ * spacemouse_reader_stop().
+ *
+ * @note No subscriber may read the device's ring anymore.
+ */
+int
+spacemouse_device_broadcast_disable(struct spacemouse *mouse);
+
+/**
+ * Subscribe to the broadcast ring of a device.
+ *
+ * The subscriber receives events published after this call.
+ *
+ * @param[out] sub Subscriber to be initialized.
+ * @param mouse The device to subscribe to, broadcasting must be enabled.
+ *
+ * @return 0 on success or negative errno on error.
+ */
+int
+spacemouse_subscriber_init(struct spacemouse_subscriber *sub,
+                           struct spacemouse *mouse);
+
+/**
+ * Read the next event from a device's broadcast ring.
+ *
+ * Wait-free, never blocks the producer or other subscribers.
+ *
+ * @param sub The subscriber reading.
+ * @param[out] event Event which on SUCCESS is set to the next event.
+ *
+ * @return SUCCESS when an event was read, IGNORE when there is no new event,
+ * or the next event was overwritten while reading it.
+ */
+enum spacemouse_read_result
+spacemouse_subscriber_read(struct spacemouse_subscriber *sub,
+                           spacemouse_event_t *event);
+
+/**
+ * Start a library managed thread reading a device.
+ *
+ * The thread reads the device with spacemouse_device_read_event() and
+ * publishes every event to the device's broadcast ring, from which
+ * subscribers read. Its loop does not allocate and makes no syscall other
+ * than the blocking device read.
+ *
+ * For real-time use the thread can be pinned to CPUs, run under SCHED_FIFO
+ * and have its buffers locked in memory. The delay between the kernel
+ * timestamping a report and the thread publishing it is reported in the
+ * device's stats, see spacemouse_device_get_stats().
+ *
+ * @param mouse The device to be read, it must be opened and broadcasting must
+ * be enabled with spacemouse_device_broadcast_enable().
+ * @param config Options of the thread, or NULL for defaults.
+ *
+ * @return 0 on success or negative errno on error, e.g. -EPERM when the
+ * process is not allowed to use SCHED_FIFO.
+ */
+int
+spacemouse_reader_start(struct spacemouse *mouse,
+                        struct spacemouse_reader_config const *config);
+
+/**
+ * Stop the reader thread of a device.
+ *
+ * Must be called before the device is closed.
+ *
+ * @param mouse The device of which the reader is to be stopped.
+ *
+ * @return 0 when the reader was running fine, or the negative errno which
+ * ended the reader's loop, e.g. -ENODEV when the device was disconnected.
+ */
+int
+spacemouse_reader_stop(struct spacemouse *mouse);
+
+/**
+ * Open a publisher which streams events to a remote receiver over UDP.
+ *
+ * Events passed to spacemouse_stream_publish() are batched into datagrams,
+ * with the kernel timestamp of each event and a sequence number per datagram.
+ * Motion events of a device within a datagram are coalesced into the latest.
+ * spacemouse_stream_flush() sends all queued datagrams with one syscall.
+ *
+ * @param host Name or address of the receiver, may be a multicast address.
+ * @param port UDP port of the receiver.
+ *
+ * @return The socket's file descriptor or negative errno on error.
+ *
+ * @note There is one publisher per process, it is not thread-safe.
+ */
+int
+spacemouse_stream_open(char const *host, unsigned short port);
+
+/**
+ * Queue an event of a device for the publisher.
+ *
+ * The maximum axis deviation of the device is sent along, receivers return it
+ * from spacemouse_device_get_max_axis_deviation() of the remote device.
+ *
+ * @param mouse The device which reported the event.
+ * @param event The event, as returned by spacemouse_device_read_event().
+ * @param time Time of the event in seconds since the epoch, in the clock of
+ * evdev (CLOCK_REALTIME), e.g. spacemouse_device_get_frame_time() after the
+ * event was read, or 0 for the current time.
+ *
+ * @return 0 on success or negative errno on error.
+ */
+int
+spacemouse_stream_publish(struct spacemouse *mouse,
+                          spacemouse_event_t const *event, double time);
+
+/**
+ * Send all queued events.
+ *
+ * Called by spacemouse_stream_publish() when the queue is full, the
+ * application should call it after each batch of reads, e.g. when select
+ * reports no more readable devices.
+ *
+ * When nothing is queued an empty datagram is sent, which keeps the devices
+ * of the publisher alive at a receiver with an idle timeout, see
+ * spacemouse_stream_set_idle_timeout().
+ *
+ * @return Number of datagrams sent or negative errno on error.
+ */
+int
+spacemouse_stream_flush(void);
+
+/**
+ * Close the publisher, events which are not flushed are discarded.
+ *
+ * @return 0 on success or negative errno on error.
+ */
+int
+spacemouse_stream_close(void);
+
+/**
+ * Open a receiver of events streamed by spacemouse_stream_open().
+ *
+ * Every device of a publisher shows up as a device in the device list, with
+ * devnode "udp://<publisher address>:<port>/<session>/<remote id>", where the
+ * session is 8 hex digits which change when the publisher is restarted. It is
+ * opened and read with the normal device functions, ioctl based functions
+ * like spacemouse_device_set_grab() fail on it.
+ *
+ * @param host Local address to bind to, or NULL for all addresses.
+ * @param port UDP port to receive on.
+ *
+ * @return File descriptor of the socket, which can be used with select, poll,
+ * etc., or negative errno on error.
+ */
+int
+spacemouse_stream_receiver_open(char const *host, unsigned short port);
+
+/**
+ * Receive streamed events, blocks until a datagram is available and handles
+ * all datagrams that are queued.
+ *
+ * Events are passed on to their remote device, to be read with
+ * spacemouse_device_read_event(). Events of a device which is not open are
+ * dropped. When the buffer of a device which is not read fast enough is full,
+ * its newest motion event waits for room, replacing an older waiting one,
+ * and other events are dropped. Waiting events are passed on by later calls,
+ * a blocking call also waits for room. Motion events which are older than
+ * the last delivered motion event of the device, as their datagram was
+ * reordered, are dropped.
+ *
+ * A publisher has at most 8 devices, records of further devices are counted
+ * as invalid.
+ *
+ * Devices of a publisher which restarted, or which was not heard from within
+ * the idle timeout, are removed, one per call and before datagrams are
+ * received. A blocking call returns when a device times out.
+ *
+ * @param[out] mouse_ptr Set to the remote device which was added, on
+ * SPACEMOUSE_ACTION_ADD, or removed, on SPACEMOUSE_ACTION_REMOVE. A removed
+ * device is valid until the next device is removed, see spacemouse_monitor().
+ *
+ * @return SPACEMOUSE_ACTION_ADD when a device of a publisher is seen for the
+ * first time, SPACEMOUSE_ACTION_REMOVE when a device is removed,
+ * SPACEMOUSE_ACTION_IGNORE otherwise, or negative errno on error. When
+ * several devices are seen at once, only the first is returned, all are added
+ * to the device list. When a record can not be handled, e.g. -ENOMEM when its
+ * device can not be added, the other records are handled and the error is
+ * returned when no device was added.
+ */
+enum spacemouse_action
+spacemouse_stream_receive(struct spacemouse **mouse_ptr);
+
+/**
+ * Remove the devices of publishers which send nothing for a while.
+ *
+ * Publishers of which devices are at rest need to call
+ * spacemouse_stream_flush() more often than the timeout to keep them.
+ *
+ * @param seconds Idle time after which the devices of a publisher are
+ * removed, 0 to keep them until the publisher restarts (the default).
+ *
+ * @return 0 on success or negative errno on error.
+ */
+int
+spacemouse_stream_set_idle_timeout(unsigned int seconds);
+
+/**
+ * Close the receiver, all remote devices are removed from the device list.
+ *
+ * @return 0 on success or negative errno on error.
+ */
+int
+spacemouse_stream_receiver_close(void);
+
+/**
+ * Get the counters of the stream publisher and receiver.
+ *
+ * @param[out] stats Filled with the counters.
+ */
+void
+spacemouse_stream_get_stats(struct spacemouse_stream_stats *stats);
+
+/**
+ * Reset the counters of the stream publisher and receiver.
+ */
+void
+spacemouse_stream_reset_stats(void);
+
+/**
+ * Set up a merged reader, which delivers the events of several devices as a
+ * single stream ordered by kernel timestamp.
+ *
+ * The timestamps are those of evdev, in CLOCK_REALTIME. max_latency is
+ * measured against gettimeofday(), so a step of the system clock delays or
+ * hastens held back frames by the size of the step.
+ *
+ * Each device has a window of buffered frames. The oldest buffered frame is
+ * delivered as soon as every device has a frame buffered, or when no frame
+ * of a device has arrived within max_latency. A larger max_latency orders
+ * events of devices with a busy host more strictly, a smaller one delivers
+ * events sooner.
+ *
+ * @param max_devices Maximum number of devices which can be added at the same
+ * time.
+ * @param max_latency Maximum time in microseconds a frame is held back to wait
+ * for older frames of other devices.
+ *
+ * @return 0 on success or negative errno on error.
+ */
+int
+spacemouse_merge_open(unsigned int max_devices, unsigned int max_latency);
+
+/**
+ * Add a device to the merged reader.
+ *
+ * @param mouse The device to be added, it must be opened.
+ *
+ * @return 0 on success or negative errno on error.
+ */
+int
+spacemouse_merge_add_device(struct spacemouse *mouse);
+
+/**
+ * Remove a device from the merged reader, its buffered events are dropped.
+ *
+ * Must be called before a device is closed, when a device is reported
+ * removed by spacemouse_monitor() or when reading it failed.
+ *
+ * @param mouse The device to be removed.
+ *
+ * @return 0 on success or negative errno on error.
+ */
+int
+spacemouse_merge_remove_device(struct spacemouse *mouse);
+
+/**
+ * Read events of all added devices in timestamp order.
+ *
+ * Events are decoded by spacemouse_device_read_event(). A device of which a
+ * read fails, or which was closed without being removed (-EBADF), is no
+ * longer read, its buffered events are still delivered.
+ *
+ * @param[out] events Array which is filled with events.
+ * @param max_events Size of the events array.
+ * @param wait Set to 1 to block until at least one event is available, or 0
+ * to return immediately.
+ *
+ * @return Number of events filled in, or negative errno on error, the read
+ * error of a device when no device can be read anymore.
+ */
+int
+spacemouse_merge_read_events(struct spacemouse_merge_event *events,
+                             int max_events, int wait);
+
+/**
+ * Tear down the merged reader.
+ *
+ * @return 0 on success or negative errno on error.
+ */
+int
+spacemouse_merge_close(void);
+
+/**
+ * Set up the io_uring based reader.
+ *
+ * The io_uring reader keeps a read posted on the file descriptor of every
+ * added device, and a poll on the monitor file descriptor, and harvests their
+ * completions in batches, saving a read syscall per device per wakeup.
+ *
+ * Only available when the library is built with IO_URING=1, otherwise
+ * all spacemouse_uring_* functions return -ENOSYS and the blocking
+ * spacemouse_device_read_event() should be used.
+ *
+ * @param max_devices Maximum number of devices which can be added at the same
+ * time.
+ *
+ * @return File descriptor of the ring, which can be used with select, poll,
+ * etc., or negative errno on error.
+ */
+int
+spacemouse_uring_open(unsigned int max_devices);
+
+/**
+ * Start reading an opened device through the io_uring reader.
+ *
+ * @param mouse The device to be added, it's file descriptor must be opened by
+ * spacemouse_device_open(mouse).
+ *
+ * @return 0 on success or negative errno on error.
+ */
+int
+spacemouse_uring_add_device(struct spacemouse *mouse);
+
+/**
+ * Stop reading a device through the io_uring reader.
+ *
+ * Must be called before a device is closed or when a device is reported
+ * removed by spacemouse_monitor().
+ *
+ * @param mouse The device to be removed.
+ *
+ * @return 0 on success or negative errno on error.
+ */
+int
+spacemouse_uring_remove_device(struct spacemouse *mouse);
+
+/**
+ * Watch the monitor file descriptor through the io_uring reader.
+ *
+ * @param monitor_fd File descriptor returned by spacemouse_monitor_open().
+ *
+ * @return 0 on success or negative errno on error.
+ */
+int
+spacemouse_uring_add_monitor(int monitor_fd);
+
+/**
+ * Harvest events of all added devices.
+ *
+ * Events are decoded the same way as by spacemouse_device_read_event().
+ * Consecutive motion events of a device within one call are coalesced into
+ * the latest one, with period set to the sum of their periods. A device of
+ * which a read fails is reported once, with the error set.
+ *
+ * @param[out] events Array which is filled with harvested events.
+ * @param max_events Size of the events array.
+ * @param wait Set to 1 to block until at least one event is available, or 0
+ * to return immediately.
+ *
+ * @return Number of events filled in, or negative errno on error.
+ */
+int
+spacemouse_uring_read_events(struct spacemouse_uring_event *events,
+                             int max_events, int wait);
+
+/**
+ * Tear down the io_uring reader.
+ *
+ * @return 0 on success or negative errno on error.
+ */
+int
+spacemouse_uring_close(void);
+
 #ifdef __cplusplus
 }
 #endif
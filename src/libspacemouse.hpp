@@ -0,0 +1,371 @@
+/*
+Copyright (c) 2013 Rolf Morel
+
+libspacemouse - a free software driver for 3D/6DoF input devices.
+
+libspacemouse is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+libspacemouse is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libspacemouse.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** @file
+ * Header-only C++20 wrapper around libspacemouse.h.
+ *
+ * Errors reported by the C library as negative errno values are thrown as
+ * std::system_error. Apart from throwing, the wrappers do not allocate.
+ */
+
+#ifndef _LIBSPACEMOUSE_HPP_
+#define _LIBSPACEMOUSE_HPP_
+
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <iterator>
+#include <span>
+#include <system_error>
+#include <utility>
+
+#include "libspacemouse.h"
+
+namespace libspacemouse {
+
+namespace detail {
+
+/* The C library returns either a negative errno or -1 with errno set. */
+inline int check(int ret, char const *what)
+{
+  if (ret < 0)
+    throw std::system_error(ret == -1 ? errno : -ret, std::generic_category(),
+                            what);
+  return ret;
+}
+
+} /* namespace detail */
+
+enum class event_type {
+  none = 0,
+  motion = SPACEMOUSE_EVENT_MOTION,
+  button = SPACEMOUSE_EVENT_BUTTON,
+  led = SPACEMOUSE_EVENT_LED
+};
+
+/**
+ * Decoded event, layout compatible with spacemouse_event_t.
+ *
+ * The accessors return NULL when the event is of another type.
+ */
+struct event {
+  spacemouse_event_t raw;
+
+  event_type type() const noexcept
+  {
+    return static_cast<event_type>(raw.type);
+  }
+
+  spacemouse_event_motion const *motion() const noexcept
+  {
+    return raw.type == SPACEMOUSE_EVENT_MOTION ? &raw.motion : nullptr;
+  }
+
+  spacemouse_event_button const *button() const noexcept
+  {
+    return raw.type == SPACEMOUSE_EVENT_BUTTON ? &raw.button : nullptr;
+  }
+
+  spacemouse_event_led const *led() const noexcept
+  {
+    return raw.type == SPACEMOUSE_EVENT_LED ? &raw.led : nullptr;
+  }
+};
+
+/**
+ * Non-owning reference to a node of the library's device list.
+ */
+class device_ref {
+public:
+  device_ref(struct spacemouse *mouse = nullptr) noexcept : mouse_(mouse) {}
+
+  struct spacemouse *get() const noexcept { return mouse_; }
+  explicit operator bool() const noexcept { return mouse_ != nullptr; }
+
+  int id() const noexcept { return spacemouse_device_get_id(mouse_); }
+  int fd() const noexcept { return spacemouse_device_get_fd(mouse_); }
+
+  char const *devnode() const noexcept
+  {
+    return spacemouse_device_get_devnode(mouse_);
+  }
+
+  char const *manufacturer() const noexcept
+  {
+    return spacemouse_device_get_manufacturer(mouse_);
+  }
+
+  char const *product() const noexcept
+  {
+    return spacemouse_device_get_product(mouse_);
+  }
+
+  char const *serial() const noexcept
+  {
+    return spacemouse_device_get_serial(mouse_);
+  }
+
+  spacemouse_stats stats() const noexcept
+  {
+    spacemouse_stats stats;
+
+    spacemouse_device_get_stats(mouse_, &stats);
+    return stats;
+  }
+
+  friend bool operator==(device_ref a, device_ref b) noexcept
+  {
+    return a.mouse_ == b.mouse_;
+  }
+
+protected:
+  struct spacemouse *mouse_;
+};
+
+/**
+ * Range over the library's device list, usable in range-based for loops.
+ */
+class device_list {
+public:
+  class iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = device_ref;
+    using difference_type = std::ptrdiff_t;
+    using pointer = device_ref const *;
+    using reference = device_ref;
+
+    iterator(struct spacemouse *mouse = nullptr) noexcept : mouse_(mouse) {}
+
+    device_ref operator*() const noexcept { return device_ref(mouse_); }
+
+    iterator &operator++() noexcept
+    {
+      mouse_ = spacemouse_device_list_get_next(mouse_);
+      return *this;
+    }
+
+    iterator operator++(int) noexcept
+    {
+      iterator prev = *this;
+      ++*this;
+      return prev;
+    }
+
+    friend bool operator==(iterator a, iterator b) noexcept
+    {
+      return a.mouse_ == b.mouse_;
+    }
+
+  private:
+    struct spacemouse *mouse_;
+  };
+
+  /**
+   * @param update Set to true to initialize/update the internal device list,
+   * see spacemouse_device_list().
+   */
+  explicit device_list(bool update = false)
+  {
+    detail::check(spacemouse_device_list(&head_, update ? 1 : 0),
+                  "spacemouse_device_list");
+  }
+
+  iterator begin() const noexcept { return iterator(head_); }
+  iterator end() const noexcept { return iterator(); }
+  bool empty() const noexcept { return head_ == nullptr; }
+
+private:
+  struct spacemouse *head_ = nullptr;
+};
+
+/**
+ * Opened device, closes the device node on destruction.
+ *
+ * The handle must not outlive the device's removal from the device list, i.e.
+ * it should be destroyed when spacemouse_monitor() reports the device removed.
+ */
+class device : public device_ref {
+public:
+  explicit device(device_ref ref) : device_ref(ref)
+  {
+    detail::check(spacemouse_device_open(mouse_), "spacemouse_device_open");
+  }
+
+  device(device const &) = delete;
+  device &operator=(device const &) = delete;
+
+  device(device &&other) noexcept
+    : device_ref(std::exchange(other.mouse_, nullptr)) {}
+
+  device &operator=(device &&other) noexcept
+  {
+    if (this != &other) {
+      close();
+      mouse_ = std::exchange(other.mouse_, nullptr);
+    }
+    return *this;
+  }
+
+  ~device() { close(); }
+
+  /**
+   * Read one event, blocks until an event is available.
+   *
+   * @return false when only unuseful events were read.
+   */
+  bool read(event &ev)
+  {
+    return detail::check(spacemouse_device_read_event(mouse_, &ev.raw),
+                         "spacemouse_device_read_event") ==
+           SPACEMOUSE_READ_SUCCESS;
+  }
+
+  /**
+   * Read a batch of events into a caller owned buffer, see
+   * spacemouse_device_read_events().
+   *
+   * A read error after events were stored is not thrown, so those events are
+   * not lost; the error is thrown by the next batch read instead.
+   *
+   * @return The number of events stored at the front of buf.
+   */
+  std::size_t read(std::span<event> buf)
+  {
+    static_assert(sizeof(event) == sizeof(spacemouse_event_t));
+
+    int max = buf.size() > INT_MAX ? INT_MAX : static_cast<int>(buf.size());
+
+    if (buf.empty())
+      return 0;
+
+    return detail::check(spacemouse_device_read_events(
+                           mouse_, reinterpret_cast<spacemouse_event_t *>(
+                                     buf.data()), max),
+                         "spacemouse_device_read_events");
+  }
+
+  int max_axis_deviation() const
+  {
+    return detail::check(spacemouse_device_get_max_axis_deviation(mouse_),
+                         "spacemouse_device_get_max_axis_deviation");
+  }
+
+  void set_grab(bool grab)
+  {
+    detail::check(spacemouse_device_set_grab(mouse_, grab ? 1 : 0),
+                  "spacemouse_device_set_grab");
+  }
+
+  bool led() const
+  {
+    return detail::check(spacemouse_device_get_led(mouse_),
+                         "spacemouse_device_get_led") == 1;
+  }
+
+  void set_led(bool state)
+  {
+    detail::check(spacemouse_device_set_led(mouse_, state ? 1 : 0),
+                  "spacemouse_device_set_led");
+  }
+
+private:
+  void close() noexcept
+  {
+    if (mouse_ != nullptr && spacemouse_device_get_fd(mouse_) > -1)
+      spacemouse_device_close(mouse_);
+  }
+};
+
+/**
+ * Connection to the system device manager, closed on destruction.
+ *
+ * The library has one monitor per process, constructing a second one while
+ * another is open throws EBUSY.
+ */
+class monitor {
+public:
+  struct result {
+    spacemouse_action action;
+    /** New device on ADD, cached device on REMOVE. */
+    device_ref device;
+  };
+
+  monitor()
+  {
+    if (open_)
+      throw std::system_error(EBUSY, std::generic_category(),
+                              "spacemouse_monitor_open");
+
+    fd_ = detail::check(spacemouse_monitor_open(), "spacemouse_monitor_open");
+    open_ = true;
+  }
+
+  monitor(monitor const &) = delete;
+  monitor &operator=(monitor const &) = delete;
+
+  monitor(monitor &&other) noexcept : fd_(std::exchange(other.fd_, -1)) {}
+
+  monitor &operator=(monitor &&other) noexcept
+  {
+    if (this != &other) {
+      close();
+      fd_ = std::exchange(other.fd_, -1);
+      open_ = fd_ > -1;
+    }
+    return *this;
+  }
+
+  ~monitor() { close(); }
+
+  int fd() const noexcept { return fd_; }
+
+  /**
+   * Wrap spacemouse_monitor(), blocks on read.
+   */
+  result next()
+  {
+    struct spacemouse *mouse = nullptr;
+    int action = spacemouse_monitor(&mouse);
+
+    detail::check(action, "spacemouse_monitor");
+
+    return result{ static_cast<spacemouse_action>(action),
+                   action == SPACEMOUSE_ACTION_IGNORE ? device_ref()
+                                                      : device_ref(mouse) };
+  }
+
+private:
+  void close() noexcept
+  {
+    if (fd_ > -1) {
+      spacemouse_monitor_close();
+      fd_ = -1;
+      open_ = false;
+    }
+  }
+
+  int fd_ = -1;
+  /* whether a monitor object holds the library's monitor */
+  inline static bool open_ = false;
+};
+
+} /* namespace libspacemouse */
+
+#endif
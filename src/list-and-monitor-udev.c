@@ -18,7 +18,6 @@ along with libspacemouse.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <stdlib.h>
-#include <unistd.h>
 #include <string.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -27,144 +26,112 @@ along with libspacemouse.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "libspacemouse.h"
 #include "types.h"
-
-static struct spacemouse *spacemouse_head = NULL;
-
-static int new_device_id = 1;
+#include "internal.h"
 
 static struct udev *udev = NULL;
 static struct udev_monitor *udev_monitor = NULL;
 
-static struct spacemouse *devnode_used_in_list(char const *devnode)
+static unsigned int hex_id(char const *str)
 {
-  struct spacemouse *iter = spacemouse_head;
-
-  for ( ; iter; iter = iter->next)
-    if (strcmp(iter->devnode, devnode) == 0)
-      return iter;
-
-  return NULL;
+  return str != NULL ? (unsigned int)strtoul(str, NULL, 16) : 0;
 }
 
-static struct spacemouse *add_device(char const *devnode,
-                                     char const *manufacturer,
-                                     char const *product)
+/* Match an input device against the table of supported devices.
+ *
+ * Uses the ids udev already has in its database, and only falls back to
+ * reading sysfs attributes of the usb parent when they are missing. */
+static int match_device(struct udev_device *dev, struct udev_device *parent,
+                        unsigned int *vendor_id, unsigned int *product_id)
 {
-  struct spacemouse *mouse, *iter = spacemouse_head;
+  char const *vendor = udev_device_get_property_value(dev, "ID_VENDOR_ID");
+  char const *model = udev_device_get_property_value(dev, "ID_MODEL_ID");
 
-  if ((mouse = malloc(sizeof *mouse)) == NULL)
-    return NULL;
-
-  mouse->id = new_device_id++;
-  mouse->fd = -1;
-  mouse->data = NULL;
-
-  if ((mouse->devnode = malloc(strlen(devnode) + 1)) == NULL) {
-    free(mouse); return NULL;
+  if (vendor == NULL || model == NULL) {
+    vendor = udev_device_get_sysattr_value(parent, "idVendor");
+    model = udev_device_get_sysattr_value(parent, "idProduct");
   }
-  strcpy(mouse->devnode, devnode);
 
-  if ((mouse->manufacturer = malloc(strlen(manufacturer) + 1)) == NULL) {
-    free(mouse->devnode); free(mouse); return NULL;
-  }
-  strcpy(mouse->manufacturer, manufacturer);
+  *vendor_id = hex_id(vendor);
+  *product_id = hex_id(model);
 
-  if ((mouse->product = malloc(strlen(product) + 1)) == NULL) {
-    free(mouse->devnode); free(mouse->manufacturer); free(mouse); return NULL;
-  }
-  strcpy(mouse->product, product);
-
-  memset(&mouse->buf, 0, sizeof mouse->buf);
-
-  mouse->next = NULL;
-
-  if ((iter = spacemouse_head) == NULL)
-    return (spacemouse_head = mouse);
-  while (iter->next != NULL)
-    iter = iter->next;
-
-  return (iter->next = mouse);
+  return device_id_match(*vendor_id, *product_id);
 }
 
-static void remove_device(struct spacemouse *mouse, int list_only)
+/* Read the name strings of a matched device. */
+static void device_strings(struct udev_device *dev, struct udev_device *parent,
+                           char const **manufacturer, char const **product,
+                           char const **serial)
 {
-  struct spacemouse *iter = spacemouse_head;
-
-  for ( ; iter; iter = iter->next) {
-    if (spacemouse_head == mouse)
-      spacemouse_head = mouse->next;
-    else if (iter->next == mouse)
-      iter->next = iter->next->next;
-    else
-      continue;
-
-    if (list_only != 1) {
-      if (mouse->fd > -1) close(mouse->fd);
-      free(mouse->devnode); free(mouse->manufacturer);
-      free(mouse->product); free(mouse);
-    }
-    return;
-  }
+  if ((*manufacturer = udev_device_get_sysattr_value(parent,
+                                                     "manufacturer")) == NULL &&
+      (*manufacturer = udev_device_get_property_value(dev,
+                                                      "ID_VENDOR")) == NULL)
+    *manufacturer = "";
+
+  if ((*product = udev_device_get_sysattr_value(parent, "product")) == NULL &&
+      (*product = udev_device_get_property_value(dev, "ID_MODEL")) == NULL)
+    *product = "";
+
+  if ((*serial = udev_device_get_sysattr_value(parent, "serial")) == NULL &&
+      (*serial = udev_device_get_property_value(dev,
+                                                "ID_SERIAL_SHORT")) == NULL)
+    *serial = "";
 }
 
 /* TODO: this function only adds new devices and doesn't remove devices udev
  * no longer lists */
-int spacemouse_device_list(struct spacemouse **mouse_ptr, int update)
+int udev_backend_device_list(void)
 {
   struct udev *udev;
   struct udev_enumerate *enumerate;
   struct udev_list_entry *devices, *dev_list_entry;
   struct udev_device *dev, *dev_parent;
-  char const *syspath, *devnode, *attr_man, *attr_pro;
+  char const *syspath, *devnode, *attr_man, *attr_pro, *attr_ser;
+  unsigned int vendor_id, product_id;
+
+  /* add error check */
+  udev = udev_new();
+
+  enumerate = udev_enumerate_new(udev);
+  udev_enumerate_add_match_subsystem(enumerate, "input");
+  if (list_get_tag() != NULL)
+    udev_enumerate_add_match_tag(enumerate, list_get_tag());
+  /* devices on seat0 need not have ID_SEAT set, filter those below */
+  if (list_get_seat() != NULL && strcmp(list_get_seat(), "seat0") != 0)
+    udev_enumerate_add_match_property(enumerate, "ID_SEAT", list_get_seat());
+  udev_enumerate_scan_devices(enumerate);
+  devices = udev_enumerate_get_list_entry(enumerate);
+
+  udev_list_entry_foreach(dev_list_entry, devices) {
+    syspath = udev_list_entry_get_name(dev_list_entry);
+    dev = udev_device_new_from_syspath(udev, syspath);
 
-  if (update == 0) {
-    *mouse_ptr = spacemouse_head;
-    return 0;
-  } else if (update == 1) {
-    /* add error check */
-    udev = udev_new();
-
-    enumerate = udev_enumerate_new(udev);
-    udev_enumerate_add_match_subsystem(enumerate, "input");
-    udev_enumerate_scan_devices(enumerate);
-    devices = udev_enumerate_get_list_entry(enumerate);
-
-    udev_list_entry_foreach(dev_list_entry, devices) {
-      syspath = udev_list_entry_get_name(dev_list_entry);
-      dev = udev_device_new_from_syspath(udev, syspath);
-
-      devnode = udev_device_get_devnode(dev);
-
-      dev_parent = udev_device_get_parent_with_subsystem_devtype(dev, "usb",
-                                                                 "usb_device");
-      if (dev_parent != NULL &&
-          devnode != NULL && strstr(devnode, "event") != NULL) {
-        attr_man = udev_device_get_sysattr_value(dev_parent, "manufacturer");
-        attr_pro = udev_device_get_sysattr_value(dev_parent, "product");
-        if (attr_man != NULL && strcmp(attr_man, "3Dconnexion") == 0 &&
-            attr_pro != NULL) {
-          if (!devnode_used_in_list(devnode))
-              if (add_device(devnode, attr_man, attr_pro) == NULL)
-                return -errno;
-        }
-      }
+    devnode = udev_device_get_devnode(dev);
 
-      /* dev_parent is unreferenced/cleaned with child device */
-      udev_device_unref(dev);
+    dev_parent = udev_device_get_parent_with_subsystem_devtype(dev, "usb",
+                                                               "usb_device");
+    if (dev_parent != NULL &&
+        devnode != NULL && strstr(devnode, "event") != NULL &&
+        list_seat_match(udev_device_get_property_value(dev, "ID_SEAT")) &&
+        match_device(dev, dev_parent, &vendor_id, &product_id) &&
+        !devnode_used_in_list(devnode)) {
+      device_strings(dev, dev_parent, &attr_man, &attr_pro, &attr_ser);
+      if (add_device(devnode, vendor_id, product_id,
+                     attr_man, attr_pro, attr_ser) == NULL)
+        return -errno;
     }
 
-    udev_enumerate_unref(enumerate);
-    udev_unref(udev);
-
-  } else
-    return -EINVAL;
+    /* dev_parent is unreferenced/cleaned with child device */
+    udev_device_unref(dev);
+  }
 
-  *mouse_ptr = spacemouse_head;
+  udev_enumerate_unref(enumerate);
+  udev_unref(udev);
 
   return 0;
 }
 
-int spacemouse_monitor_open(void)
+int udev_backend_monitor_open(void)
 {
   int fd;
 
@@ -177,6 +144,9 @@ int spacemouse_monitor_open(void)
     udev_monitor = udev_monitor_new_from_netlink(udev, "udev");
     udev_monitor_filter_add_match_subsystem_devtype(udev_monitor, "input",
                                                     NULL);
+    /* filtered in the kernel, before the event reaches this process */
+    if (list_get_tag() != NULL)
+      udev_monitor_filter_add_match_tag(udev_monitor, list_get_tag());
     udev_monitor_enable_receiving(udev_monitor);
   }
 
@@ -190,11 +160,11 @@ int spacemouse_monitor_open(void)
   return fd;
 }
 
-enum spacemouse_action spacemouse_monitor(struct spacemouse **mouse_ptr)
+enum spacemouse_action udev_backend_monitor(struct spacemouse **mouse_ptr)
 {
-  static struct spacemouse *cache_mouse = NULL;
   struct udev_device *dev, *dev_parent;
-  char const *devnode, *action_str, *attr_man, *attr_pro;
+  char const *devnode, *action_str, *attr_man, *attr_pro, *attr_ser;
+  unsigned int vendor_id, product_id;
 
   int action = -1;
 
@@ -206,38 +176,34 @@ enum spacemouse_action spacemouse_monitor(struct spacemouse **mouse_ptr)
     action = SPACEMOUSE_ACTION_IGNORE;
 
     devnode = udev_device_get_devnode(dev);
+    action_str = udev_device_get_action(dev);
+
+    PROBE2(uevent, action_str, devnode);
 
     dev_parent = udev_device_get_parent_with_subsystem_devtype(dev,
         "usb", "usb_device");
 
-    attr_man = udev_device_get_sysattr_value(dev_parent, "manufacturer");
-    attr_pro = udev_device_get_sysattr_value(dev_parent, "product");
-
     if (devnode != NULL && strstr(devnode, "event") != NULL &&
         dev_parent != NULL) {
       struct spacemouse *mouse = devnode_used_in_list(devnode);
 
-      action_str = udev_device_get_action(dev);
-      if (strcmp(action_str, "add") == 0 &&
-          mouse == NULL && attr_pro != NULL &&
-          attr_man != NULL && strcmp(attr_man, "3Dconnexion") == 0) {
-        *mouse_ptr = add_device(devnode, attr_man, attr_pro);
+      if (strcmp(action_str, "add") == 0 && mouse == NULL &&
+          list_seat_match(udev_device_get_property_value(dev, "ID_SEAT")) &&
+          match_device(dev, dev_parent, &vendor_id, &product_id)) {
+        device_strings(dev, dev_parent, &attr_man, &attr_pro, &attr_ser);
+        *mouse_ptr = add_device(devnode, vendor_id, product_id,
+                                attr_man, attr_pro, attr_ser);
 
         action = (*mouse_ptr) == NULL ? -errno : SPACEMOUSE_ACTION_ADD;
-      } else if (strcmp(action_str, "remove") == 0 && mouse != NULL) {
-        if (cache_mouse != NULL) {
-          if (cache_mouse->fd > -1) close(cache_mouse->fd);
-          free(cache_mouse->devnode); free(cache_mouse->manufacturer);
-          free(cache_mouse->product); free(cache_mouse);
-        }
-
-        remove_device(mouse, 1);
-        cache_mouse = mouse;
-        cache_mouse->next = NULL;
 
-        *mouse_ptr = cache_mouse;
+        if (action == SPACEMOUSE_ACTION_ADD)
+          PROBE2(add, (*mouse_ptr)->id, devnode);
+      } else if (strcmp(action_str, "remove") == 0 && mouse != NULL) {
+        *mouse_ptr = remove_device_cached(mouse);
 
         action = SPACEMOUSE_ACTION_REMOVE;
+
+        PROBE2(remove, mouse->id, devnode);
       }
     }
 
@@ -248,12 +214,15 @@ enum spacemouse_action spacemouse_monitor(struct spacemouse **mouse_ptr)
   return action;
 }
 
-int spacemouse_monitor_close(void)
+int udev_backend_monitor_close(void)
 {
   if (udev_monitor)
     udev_monitor_unref(udev_monitor);
   if (udev)
     udev_unref(udev);
 
+  udev_monitor = NULL;
+  udev = NULL;
+
   return 0;
 }
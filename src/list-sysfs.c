@@ -0,0 +1,228 @@
+/*
+Copyright (c) 2013 Rolf Morel
+
+libspacemouse - a free software driver for 3D/6DoF input devices.
+
+libspacemouse is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+libspacemouse is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libspacemouse.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+
+#include "libspacemouse.h"
+#include "types.h"
+#include "internal.h"
+
+#define ROOT_LEN 256
+#define PATH_LEN 1024
+#define ATTR_LEN 256
+
+static char sysroot[ROOT_LEN] = "";
+
+int spacemouse_set_sysroot(char const *root)
+{
+  if (root == NULL)
+    root = "";
+
+  if (strlen(root) >= ROOT_LEN)
+    return -ENAMETOOLONG;
+
+  strcpy(sysroot, root);
+
+  /* strip trailing slashes, paths are appended as "/sys/..." */
+  while (sysroot[0] != '\0' && sysroot[strlen(sysroot) - 1] == '/')
+    sysroot[strlen(sysroot) - 1] = '\0';
+
+  return 0;
+}
+
+char const *sysfs_get_sysroot(void)
+{
+  return sysroot;
+}
+
+/* Format a path, returns -1 when it does not fit in size. */
+static int format_path(char *buf, size_t size, char const *fmt, ...)
+{
+  va_list ap;
+  int len;
+
+  va_start(ap, fmt);
+  len = vsnprintf(buf, size, fmt, ap);
+  va_end(ap);
+
+  return len < 0 || (size_t)len >= size ? -1 : 0;
+}
+
+/* Read a sysfs attribute with a single open/read/close, strips the trailing
+ * newline. Returns the length of the value or -1 on error. */
+static int read_attr(char const *path, char *buf, size_t size)
+{
+  ssize_t len;
+  int fd;
+
+  if ((fd = open(path, O_RDONLY)) == -1)
+    return -1;
+
+  do {
+    len = read(fd, buf, size - 1);
+  } while (len == -1 && errno == EINTR);
+
+  close(fd);
+
+  if (len < 0)
+    return -1;
+
+  while (len > 0 && buf[len - 1] == '\n')
+    len--;
+  buf[len] = '\0';
+
+  return len;
+}
+
+static int read_hex_attr(char const *dir, char const *name, unsigned int *val)
+{
+  char path[PATH_LEN], buf[16];
+
+  if (format_path(path, sizeof path, "%s/%s", dir, name) == -1 ||
+      read_attr(path, buf, sizeof buf) <= 0)
+    return -1;
+
+  *val = (unsigned int)strtoul(buf, NULL, 16);
+
+  return 0;
+}
+
+/* Find the value of key in a uevent file, e.g. DEVNAME=input/event5, of
+ * which the lines have been split into NUL terminated strings. */
+static char const *uevent_value(char const *uevent, int len, char const *key)
+{
+  size_t key_len = strlen(key);
+  char const *line = uevent, *end = uevent + len;
+
+  for ( ; line < end; line += strlen(line) + 1)
+    if (strncmp(line, key, key_len) == 0 && line[key_len] == '=')
+      return line + key_len + 1;
+
+  return NULL;
+}
+
+struct spacemouse *sysfs_add_device(char const *syspath)
+{
+  char dir[PATH_LEN], path[PATH_LEN], devnode[PATH_LEN];
+  char uevent[ATTR_LEN], manufacturer[ATTR_LEN], product[ATTR_LEN];
+  char serial[ATTR_LEN];
+  char const *devname;
+  unsigned int vendor_id, product_id;
+  int i, len;
+
+  /* ids of the input device, i.e. the parent of the event device */
+  if (format_path(dir, sizeof dir, "%s/device/id", syspath) == -1 ||
+      read_hex_attr(dir, "vendor", &vendor_id) == -1 ||
+      read_hex_attr(dir, "product", &product_id) == -1) {
+    errno = ENODEV;
+    return NULL;
+  }
+
+  if (!device_id_match(vendor_id, product_id)) {
+    errno = 0;
+    return NULL;
+  }
+
+  if (format_path(path, sizeof path, "%s/uevent", syspath) == -1 ||
+      (len = read_attr(path, uevent, sizeof uevent)) == -1) {
+    errno = ENODEV;
+    return NULL;
+  }
+
+  for (i = 0; i < len; i++)
+    if (uevent[i] == '\n')
+      uevent[i] = '\0';
+
+  if ((devname = uevent_value(uevent, len, "DEVNAME")) == NULL) {
+    errno = ENODEV;
+    return NULL;
+  }
+
+  if (format_path(devnode, sizeof devnode, "%s/dev/%s", sysroot,
+                  devname) == -1) {
+    errno = ENODEV;
+    return NULL;
+  }
+
+  if (devnode_used_in_list(devnode)) {
+    errno = 0;
+    return NULL;
+  }
+
+  /* event -> input -> hid -> usb interface -> usb device */
+  if (format_path(path, sizeof path, "%s/device/device/../../manufacturer",
+                  syspath) == -1 ||
+      read_attr(path, manufacturer, sizeof manufacturer) == -1)
+    manufacturer[0] = '\0';
+
+  if (format_path(path, sizeof path, "%s/device/device/../../product",
+                  syspath) == -1 ||
+      read_attr(path, product, sizeof product) == -1) {
+    if (format_path(path, sizeof path, "%s/device/name", syspath) == -1 ||
+        read_attr(path, product, sizeof product) == -1)
+      product[0] = '\0';
+  }
+
+  if (format_path(path, sizeof path, "%s/device/device/../../serial",
+                  syspath) == -1 ||
+      read_attr(path, serial, sizeof serial) == -1)
+    serial[0] = '\0';
+
+  return add_device(devnode, vendor_id, product_id, manufacturer, product,
+                    serial);
+}
+
+int sysfs_backend_device_list(void)
+{
+  char class_dir[ROOT_LEN + 32], syspath[PATH_LEN];
+  struct dirent *entry;
+  DIR *dir;
+
+  if (format_path(class_dir, sizeof class_dir, "%s/sys/class/input",
+                  sysroot) == -1)
+    return -ENAMETOOLONG;
+
+  if ((dir = opendir(class_dir)) == NULL)
+    return -errno;
+
+  while ((entry = readdir(dir)) != NULL) {
+    if (strncmp(entry->d_name, "event", 5) != 0)
+      continue;
+
+    if (format_path(syspath, sizeof syspath, "%s/%s", class_dir,
+                    entry->d_name) == -1)
+      continue;
+
+    if (sysfs_add_device(syspath) == NULL && errno == ENOMEM) {
+      closedir(dir);
+      return -ENOMEM;
+    }
+  }
+
+  closedir(dir);
+
+  return 0;
+}
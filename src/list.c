@@ -0,0 +1,317 @@
+/*
+Copyright (c) 2013 Rolf Morel
+
+libspacemouse - a free software driver for 3D/6DoF input devices.
+
+libspacemouse is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+libspacemouse is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libspacemouse.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+#include "libspacemouse.h"
+#include "types.h"
+#include "internal.h"
+
+static struct spacemouse *spacemouse_head = NULL;
+
+static int new_device_id = 1;
+
+#ifndef SPACEMOUSE_NO_UDEV
+static enum spacemouse_backend backend = SPACEMOUSE_BACKEND_UDEV;
+#else
+static enum spacemouse_backend backend = SPACEMOUSE_BACKEND_KERNEL;
+#endif
+
+/* backend the monitor was opened with */
+static enum spacemouse_backend monitor_backend;
+
+/* only devices of this seat and with this udev tag are listed, when set */
+static char *filter_seat = NULL;
+static char *filter_tag = NULL;
+
+struct spacemouse *devnode_used_in_list(char const *devnode)
+{
+  struct spacemouse *iter = spacemouse_head;
+
+  for ( ; iter; iter = iter->next)
+    if (strcmp(iter->devnode, devnode) == 0)
+      return iter;
+
+  return NULL;
+}
+
+struct spacemouse *add_device(char const *devnode,
+                              unsigned int vendor_id,
+                              unsigned int product_id,
+                              char const *manufacturer,
+                              char const *product,
+                              char const *serial)
+{
+  struct spacemouse *mouse, *iter = spacemouse_head;
+
+  if ((mouse = malloc(sizeof *mouse)) == NULL)
+    return NULL;
+
+  mouse->id = new_device_id++;
+  mouse->fd = -1;
+  mouse->data = NULL;
+
+  mouse->vendor_id = vendor_id;
+  mouse->product_id = product_id;
+
+  if ((mouse->devnode = malloc(strlen(devnode) + 1)) == NULL) {
+    free(mouse); return NULL;
+  }
+  strcpy(mouse->devnode, devnode);
+
+  if ((mouse->manufacturer = malloc(strlen(manufacturer) + 1)) == NULL) {
+    free(mouse->devnode); free(mouse); return NULL;
+  }
+  strcpy(mouse->manufacturer, manufacturer);
+
+  if ((mouse->product = malloc(strlen(product) + 1)) == NULL) {
+    free(mouse->devnode); free(mouse->manufacturer); free(mouse); return NULL;
+  }
+  strcpy(mouse->product, product);
+
+  if ((mouse->serial = malloc(strlen(serial) + 1)) == NULL) {
+    free(mouse->devnode); free(mouse->manufacturer); free(mouse->product);
+    free(mouse); return NULL;
+  }
+  strcpy(mouse->serial, serial);
+
+  memset(&mouse->buf, 0, sizeof mouse->buf);
+
+  mouse->sample.fd = -1;
+
+  memset(&mouse->busy, 0, sizeof mouse->busy);
+
+  mouse->max_axis = 0;
+  mouse->batch_type = -1;
+  mouse->batch_error = 0;
+
+  memset(&mouse->calib, 0, sizeof mouse->calib);
+
+  memset(&mouse->probe, 0, sizeof mouse->probe);
+  mouse->probed = 0;
+
+  memset(&mouse->remote, 0, sizeof mouse->remote);
+  mouse->remote.pipe[0] = mouse->remote.pipe[1] = -1;
+
+  memset(&mouse->stats, 0, sizeof mouse->stats);
+  mouse->latency_sum = mouse->jitter_sum = 0;
+
+  mouse->broadcast = NULL;
+
+  memset(&mouse->reader, 0, sizeof mouse->reader);
+
+  mouse->next = NULL;
+
+  if ((iter = spacemouse_head) == NULL)
+    return (spacemouse_head = mouse);
+  while (iter->next != NULL)
+    iter = iter->next;
+
+  return (iter->next = mouse);
+}
+
+static void free_device(struct spacemouse *mouse)
+{
+  if (mouse->reader.running)
+    spacemouse_reader_stop(mouse);
+  if (mouse->fd > -1) close(mouse->fd);
+  if (mouse->sample.fd > -1) close(mouse->sample.fd);
+  if (mouse->remote.pipe[0] > -1) close(mouse->remote.pipe[0]);
+  if (mouse->remote.pipe[1] > -1) close(mouse->remote.pipe[1]);
+  free(mouse->devnode); free(mouse->manufacturer);
+  free(mouse->product); free(mouse->serial); free(mouse->broadcast);
+  free(mouse);
+}
+
+void remove_device(struct spacemouse *mouse, int list_only)
+{
+  struct spacemouse *iter = spacemouse_head;
+
+  for ( ; iter; iter = iter->next) {
+    if (spacemouse_head == mouse)
+      spacemouse_head = mouse->next;
+    else if (iter->next == mouse)
+      iter->next = iter->next->next;
+    else
+      continue;
+
+    if (list_only != 1)
+      free_device(mouse);
+    return;
+  }
+}
+
+struct spacemouse *remove_device_cached(struct spacemouse *mouse)
+{
+  static struct spacemouse *cache_mouse = NULL;
+
+  if (cache_mouse != NULL)
+    free_device(cache_mouse);
+
+  remove_device(mouse, 1);
+  cache_mouse = mouse;
+  cache_mouse->next = NULL;
+
+  return cache_mouse;
+}
+
+int spacemouse_set_backend(enum spacemouse_backend new_backend)
+{
+  switch (new_backend) {
+#ifndef SPACEMOUSE_NO_UDEV
+    case SPACEMOUSE_BACKEND_UDEV:
+#endif
+    case SPACEMOUSE_BACKEND_KERNEL:
+      backend = new_backend;
+      return 0;
+
+    default:
+      return -ENOTSUP;
+  }
+}
+
+/* The KERNEL backend does not know the seat and tags of a hotplugged device,
+ * the kernel reports it before udevd has written its database entry. Rather
+ * than filtering only some devices, filters are not supported. */
+static int filter_unsupported(enum spacemouse_backend used)
+{
+  return used == SPACEMOUSE_BACKEND_KERNEL &&
+         (filter_seat != NULL || filter_tag != NULL);
+}
+
+static int set_filter(char **filter, char const *value)
+{
+  char *copy = NULL;
+
+  if (value != NULL && backend == SPACEMOUSE_BACKEND_KERNEL)
+    return -ENOTSUP;
+
+  if (value != NULL) {
+    if ((copy = malloc(strlen(value) + 1)) == NULL)
+      return -errno;
+    strcpy(copy, value);
+  }
+
+  free(*filter);
+  *filter = copy;
+
+  return 0;
+}
+
+int spacemouse_set_seat(char const *seat)
+{
+  return set_filter(&filter_seat, seat);
+}
+
+int spacemouse_set_tag(char const *tag)
+{
+  return set_filter(&filter_tag, tag);
+}
+
+char const *list_get_seat(void)
+{
+  return filter_seat;
+}
+
+char const *list_get_tag(void)
+{
+  return filter_tag;
+}
+
+int list_seat_match(char const *seat)
+{
+  /* devices without ID_SEAT belong to the default seat */
+  return filter_seat == NULL ||
+         strcmp(seat != NULL ? seat : "seat0", filter_seat) == 0;
+}
+
+int spacemouse_device_list(struct spacemouse **mouse_ptr, int update)
+{
+  int ret = 0;
+
+  if (update & ~(SPACEMOUSE_LIST_UPDATE | SPACEMOUSE_LIST_PROBE))
+    return -EINVAL;
+
+  if (update & SPACEMOUSE_LIST_UPDATE) {
+    if (filter_unsupported(backend))
+      return -ENOTSUP;
+
+#ifndef SPACEMOUSE_NO_UDEV
+    if (backend == SPACEMOUSE_BACKEND_UDEV)
+      ret = udev_backend_device_list();
+    else
+#endif
+      ret = sysfs_backend_device_list();
+  }
+
+  if (ret >= 0 && update & SPACEMOUSE_LIST_PROBE)
+    ret = probe_devices(spacemouse_head);
+
+  if (ret < 0)
+    return ret;
+
+  *mouse_ptr = spacemouse_head;
+
+  return 0;
+}
+
+int spacemouse_monitor_open(void)
+{
+  if (filter_unsupported(backend))
+    return -ENOTSUP;
+
+  monitor_backend = backend;
+
+#ifndef SPACEMOUSE_NO_UDEV
+  if (monitor_backend == SPACEMOUSE_BACKEND_UDEV)
+    return udev_backend_monitor_open();
+#endif
+  return kernel_backend_monitor_open();
+}
+
+int spacemouse_monitor_open_fd(int fd)
+{
+  if (filter_unsupported(SPACEMOUSE_BACKEND_KERNEL))
+    return -ENOTSUP;
+
+  monitor_backend = SPACEMOUSE_BACKEND_KERNEL;
+
+  return kernel_backend_monitor_open_fd(fd);
+}
+
+enum spacemouse_action spacemouse_monitor(struct spacemouse **mouse_ptr)
+{
+#ifndef SPACEMOUSE_NO_UDEV
+  if (monitor_backend == SPACEMOUSE_BACKEND_UDEV)
+    return udev_backend_monitor(mouse_ptr);
+#endif
+  return kernel_backend_monitor(mouse_ptr);
+}
+
+int spacemouse_monitor_close(void)
+{
+#ifndef SPACEMOUSE_NO_UDEV
+  if (monitor_backend == SPACEMOUSE_BACKEND_UDEV)
+    return udev_backend_monitor_close();
+#endif
+  return kernel_backend_monitor_close();
+}
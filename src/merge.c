@@ -0,0 +1,363 @@
+/*
+Copyright (c) 2013 Rolf Morel
+
+libspacemouse - a free software driver for 3D/6DoF input devices.
+
+libspacemouse is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+libspacemouse is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libspacemouse.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/time.h>
+
+#include "libspacemouse.h"
+#include "types.h"
+#include "internal.h"
+
+/* frames buffered per device */
+#define MERGE_WINDOW 64
+
+struct merge_frame {
+  spacemouse_event_t event;
+  struct timeval time;
+};
+
+struct merge_source {
+  struct spacemouse *mouse;
+  int error;  /* read error, the device is no longer read */
+  int head, count;
+  struct merge_frame frames[MERGE_WINDOW];
+};
+
+static struct merge_source *sources = NULL;
+static struct pollfd *fds = NULL;
+static int *fd_source = NULL;
+static int max_sources = 0, source_count = 0;
+static long max_latency; /* us */
+
+/* min-heap of the sources with buffered frames, by their oldest frame */
+static int *heap = NULL;
+static int heap_len = 0;
+
+static struct timeval const *head_time(int src)
+{
+  return &sources[src].frames[sources[src].head].time;
+}
+
+static int before(int a, int b)
+{
+  struct timeval const *ta = head_time(a), *tb = head_time(b);
+
+  if (ta->tv_sec != tb->tv_sec)
+    return ta->tv_sec < tb->tv_sec;
+  if (ta->tv_usec != tb->tv_usec)
+    return ta->tv_usec < tb->tv_usec;
+
+  /* same timestamp, keep a stable order */
+  return sources[a].mouse->id < sources[b].mouse->id;
+}
+
+static void sift_up(int i)
+{
+  int parent, src = heap[i];
+
+  for ( ; i > 0; i = parent) {
+    parent = (i - 1) / 2;
+    if (!before(src, heap[parent]))
+      break;
+    heap[i] = heap[parent];
+  }
+
+  heap[i] = src;
+}
+
+static void sift_down(int i)
+{
+  int child, src = heap[i];
+
+  for ( ; (child = 2 * i + 1) < heap_len; i = child) {
+    if (child + 1 < heap_len && before(heap[child + 1], heap[child]))
+      child++;
+    if (!before(heap[child], src))
+      break;
+    heap[i] = heap[child];
+  }
+
+  heap[i] = src;
+}
+
+static void rebuild_heap(void)
+{
+  int i;
+
+  heap_len = 0;
+  for (i = 0; i < source_count; i++)
+    if (sources[i].count > 0)
+      heap[heap_len++] = i;
+
+  for (i = heap_len / 2 - 1; i >= 0; i--)
+    sift_down(i);
+}
+
+int spacemouse_merge_open(unsigned int max_devices, unsigned int latency)
+{
+  if (sources != NULL)
+    return -EBUSY;
+
+  if (max_devices == 0)
+    return -EINVAL;
+
+  sources = malloc(max_devices * sizeof *sources);
+  fds = malloc(max_devices * sizeof *fds);
+  fd_source = malloc(max_devices * sizeof *fd_source);
+  heap = malloc(max_devices * sizeof *heap);
+
+  if (sources == NULL || fds == NULL || fd_source == NULL || heap == NULL) {
+    spacemouse_merge_close();
+    return -ENOMEM;
+  }
+
+  max_sources = max_devices;
+  source_count = heap_len = 0;
+  max_latency = latency;
+
+  return 0;
+}
+
+int spacemouse_merge_add_device(struct spacemouse *mouse)
+{
+  struct merge_source *src;
+  int i;
+
+  if (sources == NULL)
+    return -EBADF;
+
+  if (mouse->fd < 0)
+    return -EBADF;
+
+  for (i = 0; i < source_count; i++)
+    if (sources[i].mouse == mouse)
+      return -EEXIST;
+
+  if (source_count == max_sources)
+    return -ENOSPC;
+
+  src = &sources[source_count++];
+  src->mouse = mouse;
+  src->error = 0;
+  src->head = src->count = 0;
+
+  return 0;
+}
+
+int spacemouse_merge_remove_device(struct spacemouse *mouse)
+{
+  int i;
+
+  if (sources == NULL)
+    return -EBADF;
+
+  for (i = 0; i < source_count; i++)
+    if (sources[i].mouse == mouse)
+      break;
+
+  if (i == source_count)
+    return -ENOENT;
+
+  /* buffered frames of the device are dropped */
+  memmove(&sources[i], &sources[i + 1],
+          (source_count - i - 1) * sizeof *sources);
+  source_count--;
+
+  rebuild_heap();
+
+  return 0;
+}
+
+/* Read a frame of each readable device, until no device with room in its
+ * window is readable. Waits up to timeout ms for the first. */
+static int fill(int timeout)
+{
+  struct merge_source *src;
+  struct merge_frame *frame;
+  int i, nfds, ret, read_any;
+
+  do {
+    nfds = 0;
+    for (i = 0; i < source_count; i++) {
+      /* poll ignores a closed device, which would never have a frame */
+      if (sources[i].error == 0 && sources[i].mouse->fd < 0)
+        sources[i].error = -EBADF;
+
+      if (sources[i].error == 0 && sources[i].count < MERGE_WINDOW) {
+        fds[nfds].fd = sources[i].mouse->fd;
+        fds[nfds].events = POLLIN;
+        fd_source[nfds++] = i;
+      }
+    }
+
+    if (nfds == 0)
+      return 0;
+
+    do {
+      ret = poll(fds, nfds, timeout);
+    } while (ret == -1 && errno == EINTR);
+
+    if (ret == -1)
+      return -errno;
+
+    timeout = 0;
+    read_any = 0;
+
+    for (i = 0; i < nfds; i++) {
+      if (!(fds[i].revents & (POLLIN | POLLERR | POLLHUP)))
+        continue;
+
+      src = &sources[fd_source[i]];
+      frame = &src->frames[(src->head + src->count) % MERGE_WINDOW];
+
+      /* the device is gone */
+      if (!(fds[i].revents & POLLIN)) {
+        src->error = -ENODEV;
+        continue;
+      }
+
+      ret = spacemouse_device_read_event(src->mouse, &frame->event);
+      if (ret < 0) {
+        src->error = ret;
+        continue;
+      }
+
+      read_any = 1;
+      if (ret != SPACEMOUSE_READ_SUCCESS)
+        continue;
+
+      frame->time = src->mouse->buf.frame_time;
+      if (src->count++ == 0) {
+        heap[heap_len] = fd_source[i];
+        sift_up(heap_len++);
+      }
+    }
+  } while (read_any);
+
+  return 0;
+}
+
+/* Time in us until the oldest buffered frame must be emitted, evdev
+ * timestamps are in CLOCK_REALTIME like gettimeofday(). */
+static long oldest_wait(void)
+{
+  struct timeval now;
+  struct timeval const *oldest = head_time(heap[0]);
+
+  gettimeofday(&now, NULL);
+
+  return (oldest->tv_sec - now.tv_sec) * 1000000L +
+         (oldest->tv_usec - now.tv_usec) + max_latency;
+}
+
+/* The oldest frame is next in global order when every device that is still
+ * read has a newer frame buffered, as frames of a device are in order.
+ * Otherwise it is emitted once it is max_latency old, or when a window is
+ * full and the device can not be read until frames are emitted. */
+static int can_emit(void)
+{
+  int i, waiting = 0;
+
+  if (heap_len == 0)
+    return 0;
+
+  for (i = 0; i < source_count; i++) {
+    if (sources[i].count == MERGE_WINDOW)
+      return 1;
+    if (sources[i].count == 0 && sources[i].error == 0)
+      waiting = 1;
+  }
+
+  return !waiting || oldest_wait() <= 0;
+}
+
+static int emit(struct spacemouse_merge_event *events, int max_events)
+{
+  struct merge_source *src;
+  struct merge_frame *frame;
+  int n = 0;
+
+  while (n < max_events && can_emit()) {
+    src = &sources[heap[0]];
+    frame = &src->frames[src->head];
+
+    events[n].mouse = src->mouse;
+    events[n].id = src->mouse->id;
+    events[n].event = frame->event;
+    events[n].time = frame->time.tv_sec + frame->time.tv_usec / 1e6;
+    n++;
+
+    src->head = (src->head + 1) % MERGE_WINDOW;
+    if (--src->count == 0)
+      heap[0] = heap[--heap_len];
+    if (heap_len > 0)
+      sift_down(0);
+  }
+
+  return n;
+}
+
+int spacemouse_merge_read_events(struct spacemouse_merge_event *events,
+                                 int max_events, int wait)
+{
+  int n = 0, ret, timeout = 0, i;
+  long wait_us;
+
+  if (sources == NULL)
+    return -EBADF;
+
+  if (max_events <= 0)
+    return -EINVAL;
+
+  while (1) {
+    if ((ret = fill(timeout)) < 0)
+      return ret;
+
+    if ((n = emit(events, max_events)) > 0 || !wait)
+      break;
+
+    /* nothing is read anymore, report why */
+    for (i = 0; i < source_count && sources[i].error != 0; i++)
+      ;
+    if (heap_len == 0 && i == source_count)
+      return source_count > 0 ? sources[0].error : -ENODEV;
+
+    if (heap_len == 0)
+      timeout = -1;
+    else {
+      wait_us = oldest_wait();
+      timeout = wait_us <= 0 ? 0 : (int)((wait_us + 999) / 1000);
+    }
+  }
+
+  return n;
+}
+
+int spacemouse_merge_close(void)
+{
+  free(sources); free(fds); free(fd_source); free(heap);
+
+  sources = NULL; fds = NULL; fd_source = NULL; heap = NULL;
+  max_sources = source_count = heap_len = 0;
+
+  return 0;
+}
@@ -0,0 +1,187 @@
+/*
+Copyright (c) 2013 Rolf Morel
+
+libspacemouse - a free software driver for 3D/6DoF input devices.
+
+libspacemouse is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+libspacemouse is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libspacemouse.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+
+#include "libspacemouse.h"
+#include "types.h"
+#include "internal.h"
+
+/* Multicast group the kernel sends uevents to, udevd rebroadcasts processed
+ * events on group 2. */
+#define UEVENT_GROUP_KERNEL 1
+
+#define UEVENT_LEN 8192
+
+static int uevent_fd = -1;
+static int uevent_from_kernel = 0;
+
+int kernel_backend_monitor_open(void)
+{
+  struct sockaddr_nl addr;
+  int fd;
+
+  if (uevent_fd > -1)
+    return uevent_fd;
+
+  if ((fd = socket(AF_NETLINK, SOCK_DGRAM, NETLINK_KOBJECT_UEVENT)) == -1)
+    return -errno;
+
+  memset(&addr, 0, sizeof addr);
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = UEVENT_GROUP_KERNEL;
+
+  if (bind(fd, (struct sockaddr *)&addr, sizeof addr) == -1) {
+    int err = errno;
+
+    close(fd);
+    return -err;
+  }
+
+  uevent_from_kernel = 1;
+
+  return (uevent_fd = fd);
+}
+
+int kernel_backend_monitor_open_fd(int fd)
+{
+  if (fd < 0)
+    return -EBADF;
+
+  if (uevent_fd > -1 && uevent_fd != fd)
+    close(uevent_fd);
+
+  uevent_from_kernel = 0;
+
+  return (uevent_fd = fd);
+}
+
+/* Look up key in the NUL separated KEY=value list of a uevent message. */
+static char const *uevent_get(char const *msg, size_t len, char const *key)
+{
+  size_t key_len = strlen(key);
+  char const *end = msg + len;
+
+  /* skip the "action@devpath" header */
+  msg += strlen(msg) + 1;
+
+  for ( ; msg < end; msg += strlen(msg) + 1)
+    if (strncmp(msg, key, key_len) == 0 && msg[key_len] == '=')
+      return msg + key_len + 1;
+
+  return NULL;
+}
+
+enum spacemouse_action kernel_backend_monitor(struct spacemouse **mouse_ptr)
+{
+  char msg[UEVENT_LEN + 1], path[1024];
+  char const *action_str, *devpath, *subsystem, *devname;
+  struct sockaddr_nl addr;
+  struct iovec iov;
+  struct msghdr hdr;
+  struct spacemouse *mouse;
+  ssize_t len;
+
+  if (uevent_fd < 0)
+    return -EBADF;
+
+  iov.iov_base = msg;
+  iov.iov_len = UEVENT_LEN;
+
+  memset(&hdr, 0, sizeof hdr);
+  hdr.msg_iov = &iov;
+  hdr.msg_iovlen = 1;
+  if (uevent_from_kernel) {
+    hdr.msg_name = &addr;
+    hdr.msg_namelen = sizeof addr;
+  }
+
+  do {
+    len = recvmsg(uevent_fd, &hdr, 0);
+  } while (len == -1 && errno == EINTR);
+
+  if (len <= 0)
+    return len == 0 ? -ENODEV : -errno;
+
+  /* only trust messages sent by the kernel itself */
+  if (uevent_from_kernel && addr.nl_pid != 0)
+    return SPACEMOUSE_ACTION_IGNORE;
+
+  msg[len] = '\0';
+  if (strchr(msg, '@') == NULL)
+    return SPACEMOUSE_ACTION_IGNORE;
+
+  action_str = uevent_get(msg, len, "ACTION");
+  devpath = uevent_get(msg, len, "DEVPATH");
+  subsystem = uevent_get(msg, len, "SUBSYSTEM");
+  devname = uevent_get(msg, len, "DEVNAME");
+
+  PROBE2(uevent, action_str, devname);
+
+  if (action_str == NULL || devpath == NULL || subsystem == NULL ||
+      devname == NULL || strcmp(subsystem, "input") != 0 ||
+      strncmp(devname, "input/event", 11) != 0)
+    return SPACEMOUSE_ACTION_IGNORE;
+
+  if (strlen(devpath) + strlen(devname) + 300 > sizeof path)
+    return SPACEMOUSE_ACTION_IGNORE;
+
+  if (strcmp(action_str, "add") == 0) {
+    sprintf(path, "%s/sys%s", sysfs_get_sysroot(), devpath);
+
+    if ((mouse = sysfs_add_device(path)) == NULL)
+      return errno == 0 || errno == ENODEV ? SPACEMOUSE_ACTION_IGNORE
+                                           : -errno;
+
+    PROBE2(add, mouse->id, mouse->devnode);
+
+    *mouse_ptr = mouse;
+    return SPACEMOUSE_ACTION_ADD;
+  } else if (strcmp(action_str, "remove") == 0) {
+    sprintf(path, "%s/dev/%s", sysfs_get_sysroot(), devname);
+
+    if ((mouse = devnode_used_in_list(path)) == NULL)
+      return SPACEMOUSE_ACTION_IGNORE;
+
+    *mouse_ptr = remove_device_cached(mouse);
+
+    PROBE2(remove, mouse->id, mouse->devnode);
+
+    return SPACEMOUSE_ACTION_REMOVE;
+  }
+
+  return SPACEMOUSE_ACTION_IGNORE;
+}
+
+int kernel_backend_monitor_close(void)
+{
+  int ret = 0;
+
+  if (uevent_fd > -1)
+    ret = close(uevent_fd);
+
+  uevent_fd = -1;
+
+  return ret == -1 ? -errno : 0;
+}
@@ -0,0 +1,99 @@
+/*
+Copyright (c) 2013 Rolf Morel
+
+libspacemouse - a free software driver for 3D/6DoF input devices.
+
+libspacemouse is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+libspacemouse is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libspacemouse.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "libspacemouse.h"
+#include "internal.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define NORMALIZE_X86
+#include <immintrin.h>
+#endif
+
+/* dst and src must not overlap. */
+
+static void normalize_scalar(float *dst, int const *src, int n, float scale)
+{
+  float val;
+  int i;
+
+  for (i = 0; i < n; i++) {
+    val = src[i] * scale;
+    dst[i] = val > 1.0f ? 1.0f : val < -1.0f ? -1.0f : val;
+  }
+}
+
+#ifdef NORMALIZE_X86
+
+__attribute__((target("sse2")))
+static void normalize_sse2(float *dst, int const *src, int n, float scale)
+{
+  __m128 vscale = _mm_set1_ps(scale);
+  __m128 vmax = _mm_set1_ps(1.0f), vmin = _mm_set1_ps(-1.0f);
+  int i;
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    __m128 v = _mm_cvtepi32_ps(_mm_loadu_si128((__m128i const *)(src + i)));
+
+    v = _mm_min_ps(_mm_max_ps(_mm_mul_ps(v, vscale), vmin), vmax);
+    _mm_storeu_ps(dst + i, v);
+  }
+
+  normalize_scalar(dst + i, src + i, n - i, scale);
+}
+
+__attribute__((target("avx2")))
+static void normalize_avx2(float *dst, int const *src, int n, float scale)
+{
+  __m256 vscale = _mm256_set1_ps(scale);
+  __m256 vmax = _mm256_set1_ps(1.0f), vmin = _mm256_set1_ps(-1.0f);
+  int i;
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    __m256 v = _mm256_cvtepi32_ps(
+        _mm256_loadu_si256((__m256i const *)(src + i)));
+
+    v = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(v, vscale), vmin), vmax);
+    _mm256_storeu_ps(dst + i, v);
+  }
+
+  normalize_sse2(dst + i, src + i, n - i, scale);
+}
+
+#endif
+
+void normalize_axis(float *dst, int const *src, int n, float scale)
+{
+#ifdef NORMALIZE_X86
+  static void (*kernel)(float *, int const *, int, float) = NULL;
+
+  if (kernel == NULL) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+      kernel = normalize_avx2;
+    else if (__builtin_cpu_supports("sse2"))
+      kernel = normalize_sse2;
+    else
+      kernel = normalize_scalar;
+  }
+
+  kernel(dst, src, n, scale);
+#else
+  normalize_scalar(dst, src, n, scale);
+#endif
+}
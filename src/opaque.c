@@ -32,6 +32,10 @@ int spacemouse_device_get_fd(struct spacemouse *mouse) {
   return mouse->fd;
 }
 
+double spacemouse_device_get_frame_time(struct spacemouse *mouse) {
+  return mouse->buf.frame_time.tv_sec + mouse->buf.frame_time.tv_usec / 1e6;
+}
+
 char const * const spacemouse_device_get_devnode(struct spacemouse *mouse) {
   return mouse->devnode;
 }
@@ -45,6 +49,18 @@ char const * const spacemouse_device_get_product(struct spacemouse *mouse) {
   return mouse->product;
 }
 
+char const * const spacemouse_device_get_serial(struct spacemouse *mouse) {
+  return mouse->serial;
+}
+
+unsigned int spacemouse_device_get_vendor_id(struct spacemouse *mouse) {
+  return mouse->vendor_id;
+}
+
+unsigned int spacemouse_device_get_product_id(struct spacemouse *mouse) {
+  return mouse->product_id;
+}
+
 void spacemouse_device_set_data(struct spacemouse *mouse, void *data) {
   mouse->data = data;
 }
@@ -0,0 +1,156 @@
+/*
+Copyright (c) 2013 Rolf Morel
+
+libspacemouse - a free software driver for 3D/6DoF input devices.
+
+libspacemouse is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+libspacemouse is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libspacemouse.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <linux/input.h>
+
+#include "libspacemouse.h"
+#include "types.h"
+#include "internal.h"
+
+#define LONG_BITS (sizeof(long) * 8)
+#define NLONGS(x) (((x) + LONG_BITS - 1) / LONG_BITS)
+
+static unsigned long probe_time = 0;
+
+static unsigned long elapsed_us(struct timespec const *start)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (now.tv_sec - start->tv_sec) * 1000000L +
+         (now.tv_nsec - start->tv_nsec) / 1000;
+}
+
+/* Snapshot the current state of the buttons and absolute axes, so the first
+ * sample reflects the device's state before its first report. */
+static int probe_state(struct spacemouse *mouse)
+{
+  unsigned long keys[NLONGS(KEY_CNT)] = { 0 };
+  struct input_absinfo absinfo;
+  int button, axis;
+
+  if (ioctl(mouse->fd, EVIOCGKEY(sizeof keys), keys) == -1)
+    return -errno;
+
+  mouse->probe.buttons = 0;
+  for (button = 0; button < (int)LONG_BITS && BTN_0 + button < KEY_CNT;
+       button++)
+    if (1UL << ((BTN_0 + button) % LONG_BITS) &
+        keys[(BTN_0 + button) / LONG_BITS])
+      mouse->probe.buttons |= 1UL << button;
+
+  /* relative devices have no state, EVIOCGABS fails on them */
+  for (axis = 0; axis < 6; axis++)
+    if (ioctl(mouse->fd, EVIOCGABS(ABS_X + axis), &absinfo) == 0)
+      (&mouse->buf.motion.x)[axis] = absinfo.value;
+
+  return 0;
+}
+
+static void *probe_device(void *arg)
+{
+  struct spacemouse *mouse = arg;
+  struct spacemouse_probe *probe = &mouse->probe;
+  struct timespec start;
+  int ret;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  if ((ret = spacemouse_device_open(mouse)) >= 0) {
+    /* not all devices have the same range on every axis, not an error */
+    probe->max_axis = spacemouse_device_get_max_axis_deviation(mouse);
+
+    if ((ret = spacemouse_device_get_led(mouse)) >= 0) {
+      probe->led = ret;
+      ret = probe_state(mouse);
+    }
+
+    if (ret < 0)
+      spacemouse_device_close(mouse);
+  }
+
+  probe->error = ret < 0 ? ret : 0;
+  probe->time = elapsed_us(&start);
+
+  return NULL;
+}
+
+int probe_devices(struct spacemouse *head)
+{
+  struct spacemouse *mouse;
+  struct timespec start;
+  pthread_t *threads = NULL;
+  int count = 0, i = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for (mouse = head; mouse != NULL; mouse = mouse->next)
+    if (mouse->fd < 0 && mouse->remote.pipe[0] < 0)
+      count++;
+
+  if (count > 0 && (threads = malloc(count * sizeof *threads)) == NULL)
+    return -errno;
+
+  /* devices on slow hubs take long to open, probe them all at once */
+  for (mouse = head; mouse != NULL; mouse = mouse->next) {
+    /* streamed devices have nothing to probe */
+    if (mouse->fd > -1 || mouse->remote.pipe[0] > -1)
+      continue;
+
+    memset(&mouse->probe, 0, sizeof mouse->probe);
+    mouse->probed = 1;
+    if (pthread_create(&threads[i], NULL, probe_device, mouse) != 0)
+      probe_device(mouse);
+    else
+      i++;
+  }
+
+  while (i > 0)
+    pthread_join(threads[--i], NULL);
+
+  if (count > 0)
+    free(threads);
+
+  probe_time = elapsed_us(&start);
+
+  return 0;
+}
+
+int spacemouse_device_get_probe(struct spacemouse *mouse,
+                                struct spacemouse_probe *probe)
+{
+  if (!mouse->probed)
+    return -EINVAL;
+
+  memcpy(probe, &mouse->probe, sizeof *probe);
+
+  return 0;
+}
+
+unsigned long spacemouse_device_list_get_probe_time(void)
+{
+  return probe_time;
+}
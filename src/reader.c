@@ -0,0 +1,149 @@
+/*
+Copyright (c) 2013 Rolf Morel
+
+libspacemouse - a free software driver for 3D/6DoF input devices.
+
+libspacemouse is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+libspacemouse is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libspacemouse.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#include "libspacemouse.h"
+#include "types.h"
+#include "internal.h"
+
+/* stack touched by the reader before its loop so it never page faults */
+#define PREFAULT_STACK (64 * 1024)
+
+static void prefault_stack(void)
+{
+  volatile unsigned char stack[PREFAULT_STACK];
+  size_t i;
+
+  for (i = 0; i < sizeof stack; i += 4096)
+    stack[i] = 0;
+}
+
+static void *reader_loop(void *arg)
+{
+  struct spacemouse *mouse = arg;
+  spacemouse_event_t event;
+  int ret;
+
+  prefault_stack();
+
+  /* spacemouse_device_read_event() publishes to the broadcast ring, the
+   * blocking read is the only syscall and cancellation point in the loop */
+  do {
+    ret = spacemouse_device_read_event(mouse, &event);
+  } while (ret >= 0);
+
+  mouse->reader.error = ret;
+
+  return NULL;
+}
+
+int spacemouse_reader_start(struct spacemouse *mouse,
+                            struct spacemouse_reader_config const *config)
+{
+  pthread_attr_t attr;
+  struct sched_param param;
+  cpu_set_t cpus;
+  int i, ret;
+
+  if (mouse->fd < 0)
+    return -EBADF;
+
+  if (mouse->broadcast == NULL)
+    return -EINVAL;
+
+  if (mouse->reader.running)
+    return -EBUSY;
+
+  if ((ret = pthread_attr_init(&attr)) != 0)
+    return -ret;
+
+  if (config != NULL && config->ncpus > 0) {
+    CPU_ZERO(&cpus);
+    for (i = 0; i < config->ncpus; i++)
+      CPU_SET(config->cpus[i], &cpus);
+
+    if ((ret = pthread_attr_setaffinity_np(&attr, sizeof cpus, &cpus)) != 0)
+      goto out;
+  }
+
+  if (config != NULL && config->priority > 0) {
+    memset(&param, 0, sizeof param);
+    param.sched_priority = config->priority;
+
+    if ((ret = pthread_attr_setinheritsched(&attr,
+                                            PTHREAD_EXPLICIT_SCHED)) != 0 ||
+        (ret = pthread_attr_setschedpolicy(&attr, SCHED_FIFO)) != 0 ||
+        (ret = pthread_attr_setschedparam(&attr, &param)) != 0)
+      goto out;
+  }
+
+  if (config != NULL && config->lock_memory) {
+    if (mlock(mouse, sizeof *mouse) == -1 ||
+        mlock(mouse->broadcast, broadcast_ring_bytes(mouse->broadcast)) == -1) {
+      ret = errno;
+      goto out;
+    }
+    mouse->reader.locked = 1;
+  }
+
+  mouse->reader.error = 0;
+
+  /* fails with EPERM when SCHED_FIFO is not permitted, e.g. no
+   * CAP_SYS_NICE or RLIMIT_RTPRIO */
+  if ((ret = pthread_create(&mouse->reader.thread, &attr, reader_loop,
+                            mouse)) == 0)
+    mouse->reader.running = 1;
+
+out:
+  pthread_attr_destroy(&attr);
+
+  if (ret != 0 && mouse->reader.locked) {
+    munlock(mouse->broadcast, broadcast_ring_bytes(mouse->broadcast));
+    munlock(mouse, sizeof *mouse);
+    mouse->reader.locked = 0;
+  }
+
+  return -ret;
+}
+
+int spacemouse_reader_stop(struct spacemouse *mouse)
+{
+  if (!mouse->reader.running)
+    return -EINVAL;
+
+  pthread_cancel(mouse->reader.thread);
+  pthread_join(mouse->reader.thread, NULL);
+  mouse->reader.running = 0;
+
+  if (mouse->reader.locked) {
+    munlock(mouse->broadcast, broadcast_ring_bytes(mouse->broadcast));
+    munlock(mouse, sizeof *mouse);
+    mouse->reader.locked = 0;
+  }
+
+  /* cancelled while reading is a clean stop */
+  return mouse->reader.error;
+}
@@ -0,0 +1,141 @@
+/*
+Copyright (c) 2013 Rolf Morel
+
+libspacemouse - a free software driver for 3D/6DoF input devices.
+
+libspacemouse is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+libspacemouse is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libspacemouse.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/timerfd.h>
+
+#include "libspacemouse.h"
+#include "types.h"
+#include "internal.h"
+
+#define NSEC_PER_SEC 1000000000L
+
+static void timespec_add_ns(struct timespec *ts, long ns)
+{
+  ts->tv_sec += ns / NSEC_PER_SEC;
+  ts->tv_nsec += ns % NSEC_PER_SEC;
+  if (ts->tv_nsec >= NSEC_PER_SEC) {
+    ts->tv_sec++;
+    ts->tv_nsec -= NSEC_PER_SEC;
+  }
+}
+
+int spacemouse_device_sampling_open(struct spacemouse *mouse,
+                                    unsigned int rate)
+{
+  struct itimerspec spec;
+  int fd;
+
+  if (rate == 0 || rate > NSEC_PER_SEC)
+    return -EINVAL;
+
+  if (mouse->sample.fd > -1)
+    return -EBUSY;
+
+  if ((fd = timerfd_create(CLOCK_MONOTONIC, 0)) == -1)
+    return -errno;
+
+  mouse->sample.interval = NSEC_PER_SEC / rate;
+
+  /* first tick one interval from now, on an absolute schedule so ticks do not
+   * drift with wakeup latency */
+  clock_gettime(CLOCK_MONOTONIC, &mouse->sample.next);
+  timespec_add_ns(&mouse->sample.next, mouse->sample.interval);
+
+  spec.it_value = mouse->sample.next;
+  spec.it_interval.tv_sec = mouse->sample.interval / NSEC_PER_SEC;
+  spec.it_interval.tv_nsec = mouse->sample.interval % NSEC_PER_SEC;
+
+  if (timerfd_settime(fd, TFD_TIMER_ABSTIME, &spec, NULL) == -1) {
+    int err = errno;
+
+    close(fd);
+    return -err;
+  }
+
+  return (mouse->sample.fd = fd);
+}
+
+enum spacemouse_read_result spacemouse_device_sample(
+    struct spacemouse *mouse, spacemouse_event_t *event,
+    struct timespec *tick_time)
+{
+  struct spacemouse_stats *stats = &mouse->stats;
+  struct timespec now, tick;
+  uint64_t expirations;
+  ssize_t bytes;
+  long jitter;
+  unsigned int period;
+
+  do {
+    bytes = read(mouse->sample.fd, &expirations, sizeof expirations);
+  } while (bytes == -1 && errno == EINTR);
+
+  if (bytes != sizeof expirations)
+    return -errno;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  /* ticks missed since the last read are overruns, only the latest is
+   * emitted */
+  stats->samples++;
+  stats->sample_overruns += expirations - 1;
+  period = expirations * mouse->sample.interval / 1000000;
+
+  /* mouse->sample.next is the ideal time of the first unread tick */
+  while (--expirations > 0)
+    timespec_add_ns(&mouse->sample.next, mouse->sample.interval);
+  tick = mouse->sample.next;
+  timespec_add_ns(&mouse->sample.next, mouse->sample.interval);
+
+  jitter = (now.tv_sec - tick.tv_sec) * (NSEC_PER_SEC / 1000) +
+           (now.tv_nsec - tick.tv_nsec) / 1000;
+  if (jitter < 0)
+    jitter = 0;
+  if ((unsigned long)jitter > stats->sample_jitter_max)
+    stats->sample_jitter_max = jitter;
+  mouse->jitter_sum += jitter;
+
+  memcpy(&event->motion, &mouse->buf.motion, sizeof event->motion);
+  event->motion.type = SPACEMOUSE_EVENT_MOTION;
+  event->motion.period = period;
+  calib_apply(mouse, &event->motion);
+
+  if (tick_time != NULL)
+    *tick_time = tick;
+
+  return SPACEMOUSE_READ_SUCCESS;
+}
+
+int spacemouse_device_sampling_close(struct spacemouse *mouse)
+{
+  int ret;
+
+  if (mouse->sample.fd < 0)
+    return -EBADF;
+
+  ret = close(mouse->sample.fd);
+  mouse->sample.fd = -1;
+
+  return ret == -1 ? -errno : 0;
+}
@@ -0,0 +1,73 @@
+/*
+Copyright (c) 2013 Rolf Morel
+
+libspacemouse - a free software driver for 3D/6DoF input devices.
+
+libspacemouse is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+libspacemouse is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libspacemouse.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include <sys/time.h>
+
+#include "libspacemouse.h"
+#include "types.h"
+#include "internal.h"
+
+unsigned long stats_frame_delivered(struct spacemouse *mouse)
+{
+  struct spacemouse_stats *stats = &mouse->stats;
+  struct timeval now;
+  long latency;
+  unsigned long lat;
+  int bucket = 0;
+
+  stats->frames++;
+
+  gettimeofday(&now, NULL);
+  latency = (now.tv_sec - mouse->buf.frame_time.tv_sec) * 1000000L +
+            (now.tv_usec - mouse->buf.frame_time.tv_usec);
+  /* the wall clock may have been stepped back */
+  lat = latency < 0 ? 0 : (unsigned long)latency;
+  latency = lat;
+
+  if (stats->frames == 1 || lat < stats->latency_min)
+    stats->latency_min = lat;
+  if (lat > stats->latency_max)
+    stats->latency_max = lat;
+  mouse->latency_sum += lat;
+
+  while ((lat >>= 1) != 0 && bucket < SPACEMOUSE_LATENCY_BUCKETS - 1)
+    bucket++;
+  stats->latency_hist[bucket]++;
+
+  return latency;
+}
+
+void spacemouse_device_get_stats(struct spacemouse *mouse,
+                                 struct spacemouse_stats *stats)
+{
+  memcpy(stats, &mouse->stats, sizeof *stats);
+
+  if (stats->frames > 0)
+    stats->latency_avg = (unsigned long)(mouse->latency_sum / stats->frames);
+  if (stats->samples > 0)
+    stats->sample_jitter_avg = (unsigned long)(mouse->jitter_sum /
+                                               stats->samples);
+}
+
+void spacemouse_device_reset_stats(struct spacemouse *mouse)
+{
+  memset(&mouse->stats, 0, sizeof mouse->stats);
+  mouse->latency_sum = mouse->jitter_sum = 0;
+}
@@ -0,0 +1,856 @@
+/*
+Copyright (c) 2013 Rolf Morel
+
+libspacemouse - a free software driver for 3D/6DoF input devices.
+
+libspacemouse is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+libspacemouse is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libspacemouse.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* sendmmsg and recvmmsg */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/time.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <linux/input.h>
+
+#include "libspacemouse.h"
+#include "types.h"
+#include "internal.h"
+
+/*
+ * Datagram layout, all fields in network byte order:
+ *
+ *   header: magic (4), version (2), record count (2), session (4), seq (4)
+ *   record: device id (2), event type (1), 0 (1), max axis (2),
+ *           vendor id (2), product id (2), 0 (2), tv_sec (4), tv_usec (4),
+ *           data (6 * 4): axes for motion, bnum and press for buttons,
+ *           state for the LED
+ */
+#define STREAM_MAGIC 0x534d5354 /* "SMST" */
+#define STREAM_VERSION 1
+
+#define HEADER_LEN 16
+#define RECORD_LEN 44
+/* stays below the path MTU of common links, datagrams are never fragmented */
+#define PACKET_LEN 1200
+#define PACKET_RECORDS ((PACKET_LEN - HEADER_LEN) / RECORD_LEN)
+
+/* datagrams queued by the publisher, and received at once */
+#define STREAM_BATCH 16
+
+/* publishers tracked by the receiver for loss and reorder statistics */
+#define MAX_SOURCES 16
+/* received sequence numbers remembered behind the newest, bits of a long */
+#define SEQ_WINDOW 32
+
+#define DEVNODE_LEN 128
+#define SOURCE_NAME_LEN 80
+
+/* devices of a publisher, more are not added */
+#define MAX_REMOTE_DEVICES 8
+
+/* buffer of a remote device, bounds the latency of a device which is read
+ * late */
+#define REMOTE_PIPE_LEN 16384
+
+/* the socket and the pipes of remote devices with a frame waiting */
+#define MAX_WAIT_FDS (1 + MAX_SOURCES * MAX_REMOTE_DEVICES)
+
+struct packet {
+  unsigned char data[PACKET_LEN];
+  int count; /* records */
+};
+
+struct source {
+  struct sockaddr_storage addr;
+  socklen_t addr_len;
+  char name[SOURCE_NAME_LEN];  /* "host:port" */
+  unsigned long session;
+  unsigned long epoch;  /* new for each session, 0 for an unused entry */
+  unsigned long next_seq;
+  unsigned long seen;  /* bit n set when next_seq - 1 - n was received */
+  struct timespec last_seen;
+};
+
+static struct spacemouse_stream_stats stats;
+
+/* publisher */
+static int pub_fd = -1;
+static unsigned long pub_session, pub_seq;
+static struct packet pub_packets[STREAM_BATCH];
+static int pub_count = 0; /* packets in use, the last one is being filled */
+
+/* receiver */
+static int recv_fd = -1;
+static unsigned char recv_packets[STREAM_BATCH][PACKET_LEN];
+static struct sockaddr_storage recv_addrs[STREAM_BATCH];
+static struct mmsghdr recv_hdrs[STREAM_BATCH];
+static struct iovec recv_iovs[STREAM_BATCH];
+static struct source sources[MAX_SOURCES];
+static unsigned long next_epoch = 1;
+static unsigned int idle_timeout = 0; /* s, 0 for none */
+static struct pollfd wait_fds[MAX_WAIT_FDS];
+
+static void put16(unsigned char *p, unsigned int v)
+{
+  p[0] = v >> 8; p[1] = v;
+}
+
+static void put32(unsigned char *p, unsigned long v)
+{
+  p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+}
+
+static unsigned int get16(unsigned char const *p)
+{
+  return (unsigned int)p[0] << 8 | p[1];
+}
+
+static unsigned long get32(unsigned char const *p)
+{
+  return (unsigned long)p[0] << 24 | (unsigned long)p[1] << 16 |
+         (unsigned long)p[2] << 8 | p[3];
+}
+
+/* two's complement on the wire, independent of the host's long size */
+static long get32s(unsigned char const *p)
+{
+  unsigned long v = get32(p);
+
+  return v & 0x80000000UL ? -(long)(0xffffffffUL - v) - 1 : (long)v;
+}
+
+static int resolve(char const *host, unsigned short port, int passive,
+                   struct addrinfo **res)
+{
+  struct addrinfo hints;
+  char service[8];
+  int ret;
+
+  memset(&hints, 0, sizeof hints);
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_DGRAM;
+  hints.ai_flags = passive ? AI_PASSIVE : 0;
+
+  sprintf(service, "%u", port);
+
+  if ((ret = getaddrinfo(host, service, &hints, res)) != 0)
+    return ret == EAI_SYSTEM ? -errno : -EADDRNOTAVAIL;
+
+  return 0;
+}
+
+int spacemouse_stream_open(char const *host, unsigned short port)
+{
+  struct addrinfo *res, *ai;
+  int fd = -1, ret;
+
+  if (pub_fd > -1)
+    return -EBUSY;
+
+  if ((ret = resolve(host, port, 0, &res)) < 0)
+    return ret;
+
+  for (ai = res; ai != NULL; ai = ai->ai_next) {
+    if ((fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) == -1)
+      continue;
+    /* connected, so datagrams are sent without destination address */
+    if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+      break;
+    ret = -errno;
+    close(fd);
+    fd = -1;
+  }
+
+  freeaddrinfo(res);
+
+  if (fd == -1)
+    return ret < 0 ? ret : -errno;
+
+  pub_session = ((unsigned long)time(NULL) ^ (unsigned long)getpid() << 16) &
+                0xffffffffUL;
+  pub_seq = 0;
+  pub_count = 0;
+
+  return (pub_fd = fd);
+}
+
+static unsigned char *new_record(void)
+{
+  struct packet *packet;
+  int ret;
+
+  if (pub_count == 0 || pub_packets[pub_count - 1].count == PACKET_RECORDS) {
+    if (pub_count == STREAM_BATCH && (ret = spacemouse_stream_flush()) < 0) {
+      errno = -ret;
+      return NULL;
+    }
+    pub_packets[pub_count++].count = 0;
+  }
+
+  packet = &pub_packets[pub_count - 1];
+
+  return packet->data + HEADER_LEN + packet->count++ * RECORD_LEN;
+}
+
+/* The last record of the device in the packet being filled, when it is a
+ * motion record a newer motion event replaces it. */
+static unsigned char *last_record(int id)
+{
+  struct packet *packet;
+  unsigned char *record;
+  int i;
+
+  if (pub_count == 0)
+    return NULL;
+
+  packet = &pub_packets[pub_count - 1];
+  for (i = packet->count - 1; i >= 0; i--) {
+    record = packet->data + HEADER_LEN + i * RECORD_LEN;
+    if (get16(record) == (unsigned int)(id & 0xffff))
+      return record;
+  }
+
+  return NULL;
+}
+
+int spacemouse_stream_publish(struct spacemouse *mouse,
+                              spacemouse_event_t const *event, double time)
+{
+  unsigned char *record;
+  struct timeval now;
+  int axis, max_axis;
+
+  if (pub_fd < 0)
+    return -EBADF;
+
+  /* the evdev clock, in which frame times are */
+  if (time <= 0) {
+    gettimeofday(&now, NULL);
+    time = now.tv_sec + now.tv_usec / 1e6;
+  }
+
+  /* queried once the device is open, receivers normalize with it */
+  max_axis = spacemouse_device_get_max_axis_deviation(mouse);
+
+  if (event->type == SPACEMOUSE_EVENT_MOTION &&
+      (record = last_record(mouse->id)) != NULL &&
+      record[2] == SPACEMOUSE_EVENT_MOTION) {
+    stats.records_coalesced++;
+  } else {
+    if ((record = new_record()) == NULL)
+      return -errno;
+    stats.records_sent++;
+  }
+
+  memset(record, 0, RECORD_LEN);
+  put16(record, mouse->id);
+  record[2] = event->type;
+  put16(record + 4, max_axis > 0 ? max_axis : 0);
+  put16(record + 6, mouse->vendor_id);
+  put16(record + 8, mouse->product_id);
+  put32(record + 12, (unsigned long)time);
+  put32(record + 16, (unsigned long)((time - (unsigned long)time) * 1e6));
+
+  switch (event->type) {
+    case SPACEMOUSE_EVENT_MOTION:
+      for (axis = 0; axis < 6; axis++)
+        put32(record + 20 + axis * 4, (&event->motion.x)[axis]);
+      break;
+
+    case SPACEMOUSE_EVENT_BUTTON:
+      put32(record + 20, event->button.bnum);
+      put32(record + 24, event->button.press);
+      break;
+
+    case SPACEMOUSE_EVENT_LED:
+      put32(record + 20, event->led.state);
+      break;
+  }
+
+  return 0;
+}
+
+int spacemouse_stream_flush(void)
+{
+  struct mmsghdr hdrs[STREAM_BATCH];
+  struct iovec iovs[STREAM_BATCH];
+  int i, sent = 0, ret;
+
+  if (pub_fd < 0)
+    return -EBADF;
+
+  /* an empty datagram tells receivers the publisher is still there */
+  if (pub_count == 0)
+    pub_packets[pub_count++].count = 0;
+
+  for (i = 0; i < pub_count; i++) {
+    unsigned char *data = pub_packets[i].data;
+
+    put32(data, STREAM_MAGIC);
+    put16(data + 4, STREAM_VERSION);
+    put16(data + 6, pub_packets[i].count);
+    put32(data + 8, pub_session);
+    put32(data + 12, pub_seq);
+    pub_seq = (pub_seq + 1) & 0xffffffffUL;
+
+    iovs[i].iov_base = data;
+    iovs[i].iov_len = HEADER_LEN + pub_packets[i].count * RECORD_LEN;
+
+    memset(&hdrs[i], 0, sizeof hdrs[i]);
+    hdrs[i].msg_hdr.msg_iov = &iovs[i];
+    hdrs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  /* one syscall for the whole batch */
+  while (sent < pub_count) {
+    ret = sendmmsg(pub_fd, hdrs + sent, pub_count - sent, 0);
+    if (ret == -1 && errno == EINTR)
+      continue;
+    if (ret == -1) {
+      /* the receiver not listening is not the publisher's problem */
+      if (errno != ECONNREFUSED) {
+        ret = -errno;
+        pub_count = 0;
+        return ret;
+      }
+      ret = 1;
+      stats.send_errors++;
+    } else
+      stats.packets_sent += ret;
+    sent += ret;
+  }
+
+  pub_count = 0;
+
+  return sent;
+}
+
+int spacemouse_stream_close(void)
+{
+  int ret;
+
+  if (pub_fd < 0)
+    return -EBADF;
+
+  ret = close(pub_fd);
+  pub_fd = -1;
+  pub_count = 0;
+
+  return ret == -1 ? -errno : 0;
+}
+
+int spacemouse_stream_receiver_open(char const *host, unsigned short port)
+{
+  struct addrinfo *res, *ai;
+  int fd = -1, ret, i;
+
+  if (recv_fd > -1)
+    return -EBUSY;
+
+  if ((ret = resolve(host, port, 1, &res)) < 0)
+    return ret;
+
+  for (ai = res; ai != NULL; ai = ai->ai_next) {
+    if ((fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) == -1)
+      continue;
+    if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+      break;
+    ret = -errno;
+    close(fd);
+    fd = -1;
+  }
+
+  freeaddrinfo(res);
+
+  if (fd == -1)
+    return ret < 0 ? ret : -errno;
+
+  for (i = 0; i < STREAM_BATCH; i++) {
+    recv_iovs[i].iov_base = recv_packets[i];
+    recv_iovs[i].iov_len = PACKET_LEN;
+  }
+
+  memset(sources, 0, sizeof sources);
+
+  return (recv_fd = fd);
+}
+
+int spacemouse_stream_set_idle_timeout(unsigned int seconds)
+{
+  idle_timeout = seconds;
+
+  return 0;
+}
+
+static int earlier(struct timespec const *a, struct timespec const *b)
+{
+  return a->tv_sec != b->tv_sec ? a->tv_sec < b->tv_sec
+                                : a->tv_nsec < b->tv_nsec;
+}
+
+static long ms_since(struct timespec const *then)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (now.tv_sec - then->tv_sec) * 1000L +
+         (now.tv_nsec - then->tv_nsec) / 1000000L;
+}
+
+/* Account the sequence number of a datagram, *src_ptr is set to its
+ * publisher. Returns 0 when it is a duplicate which is to be dropped, or -1
+ * with errno set on error. */
+static int track_seq(struct sockaddr_storage const *addr, socklen_t addr_len,
+                     unsigned long session, unsigned long seq,
+                     struct source **src_ptr)
+{
+  struct source *src = NULL;
+  char host[64], service[16];
+  unsigned long ahead, behind;
+  int i;
+
+  for (i = 0; i < MAX_SOURCES && src == NULL; i++)
+    if (sources[i].epoch != 0 && sources[i].addr_len == addr_len &&
+        memcmp(&sources[i].addr, addr, addr_len) == 0)
+      src = &sources[i];
+
+  if (src == NULL) {
+    if (getnameinfo((struct sockaddr const *)addr, addr_len, host,
+                    sizeof host, service, sizeof service,
+                    NI_NUMERICHOST | NI_NUMERICSERV) != 0) {
+      errno = EINVAL;
+      return -1;
+    }
+
+    /* a free entry, or the one of the publisher heard from the longest ago,
+     * of which the devices become stale */
+    src = &sources[0];
+    for (i = 1; i < MAX_SOURCES && src->epoch != 0; i++)
+      if (sources[i].epoch == 0 ||
+          earlier(&sources[i].last_seen, &src->last_seen))
+        src = &sources[i];
+
+    memcpy(&src->addr, addr, addr_len);
+    src->addr_len = addr_len;
+    sprintf(src->name, "%s:%s", host, service);
+    src->epoch = 0;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &src->last_seen);
+  *src_ptr = src;
+
+  /* a new or restarted publisher starts a new sequence, the devices of its
+   * previous session become stale */
+  if (src->epoch == 0 || src->session != session) {
+    src->epoch = next_epoch++;
+    src->session = session;
+    src->next_seq = (seq + 1) & 0xffffffffUL;
+    src->seen = 1;
+    return 1;
+  }
+
+  ahead = (seq - src->next_seq) & 0xffffffffUL;
+  behind = (src->next_seq - 1 - seq) & 0xffffffffUL;
+
+  if (ahead < 0x80000000UL) {
+    stats.packets_lost += ahead;
+    src->seen = ahead + 1 >= SEQ_WINDOW ? 1 : (src->seen << (ahead + 1)) | 1;
+    src->next_seq = (seq + 1) & 0xffffffffUL;
+    return 1;
+  }
+
+  if (behind < SEQ_WINDOW && src->seen & 1UL << behind) {
+    stats.packets_duplicate++;
+    return 0;
+  }
+
+  /* it was counted lost when the newer datagram came in */
+  stats.packets_reordered++;
+  if (behind < SEQ_WINDOW) {
+    stats.packets_lost--;
+    src->seen |= 1UL << behind;
+  }
+
+  return 1;
+}
+
+/* A remote device of which the publisher restarted, was forgotten or, with
+ * an idle timeout, was not heard from in time. Otherwise NULL, and *timeout
+ * is set to the ms until the next device times out or -1. */
+static struct spacemouse *stale_device(int *timeout)
+{
+  struct spacemouse *mouse;
+  struct source *src;
+  long left;
+
+  *timeout = -1;
+
+  spacemouse_device_list(&mouse, 0);
+  for ( ; mouse != NULL; mouse = mouse->next) {
+    if (mouse->remote.pipe[0] < 0)
+      continue;
+
+    src = &sources[mouse->remote.source];
+    if (src->epoch != mouse->remote.epoch)
+      return mouse;
+
+    if (idle_timeout > 0) {
+      left = idle_timeout * 1000L - ms_since(&src->last_seen);
+      if (left <= 0)
+        return mouse;
+      if (*timeout == -1 || left < *timeout)
+        *timeout = (int)left;
+    }
+  }
+
+  return NULL;
+}
+
+/* The remote device of a record, which is added to the device list when it
+ * is new. Returns NULL with errno set on error, or 0 when the publisher has
+ * the maximum number of devices. */
+static struct spacemouse *remote_device(struct source *src,
+                                        unsigned char const *record,
+                                        int *added)
+{
+  char devnode[DEVNODE_LEN], product[32];
+  struct spacemouse *mouse;
+  int err, count = 0;
+
+  *added = 0;
+
+  /* the session tells the devices of a restarted publisher apart */
+  sprintf(devnode, "udp://%s/%08lx/%u", src->name, src->session,
+          get16(record));
+
+  if ((mouse = devnode_used_in_list(devnode)) != NULL)
+    return mouse;
+
+  /* every device costs a pipe, a sender can not use up the receiver's */
+  spacemouse_device_list(&mouse, 0);
+  for ( ; mouse != NULL; mouse = mouse->next)
+    if (mouse->remote.pipe[0] > -1 &&
+        mouse->remote.source == src - sources &&
+        mouse->remote.epoch == src->epoch)
+      count++;
+
+  if (count == MAX_REMOTE_DEVICES) {
+    stats.invalid++;
+    errno = 0;
+    return NULL;
+  }
+
+  sprintf(product, "Remote device %u", get16(record));
+  if ((mouse = add_device(devnode, get16(record + 6), get16(record + 8),
+                          src->name, product, "")) == NULL) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  if (pipe(mouse->remote.pipe) == -1) {
+    err = errno;
+    mouse->remote.pipe[0] = mouse->remote.pipe[1] = -1;
+    remove_device(mouse, 0);
+    errno = err;
+    return NULL;
+  }
+
+  /* a device nobody reads loses events instead of stalling the receiver */
+  fcntl(mouse->remote.pipe[1], F_SETFL,
+        fcntl(mouse->remote.pipe[1], F_GETFL) | O_NONBLOCK);
+  /* may fail, the default is larger */
+  fcntl(mouse->remote.pipe[1], F_SETPIPE_SZ, REMOTE_PIPE_LEN);
+
+  mouse->remote.source = src - sources;
+  mouse->remote.epoch = src->epoch;
+
+  *added = 1;
+
+  return mouse;
+}
+
+int stream_open_device(struct spacemouse *mouse)
+{
+  char buf[512];
+  int left, fd;
+  ssize_t len;
+
+  /* events of a previous open are stale, the pipe has no other reader */
+  if (ioctl(mouse->remote.pipe[0], FIONREAD, &left) == -1)
+    return -errno;
+
+  while (left > 0 &&
+         (len = read(mouse->remote.pipe[0], buf,
+                     left < (int)sizeof buf ? left : (int)sizeof buf)) > 0)
+    left -= len;
+
+  mouse->remote.pending_len = 0;
+
+  if ((fd = dup(mouse->remote.pipe[0])) == -1)
+    return -errno;
+
+  return fd;
+}
+
+/* Write the waiting motion frame of a device, returns -1 while the pipe has
+ * no room. */
+static int write_pending(struct spacemouse *mouse)
+{
+  struct spacemouse_remote *remote = &mouse->remote;
+  ssize_t len = remote->pending_len * sizeof *remote->pending;
+
+  if (remote->pending_len == 0)
+    return 0;
+
+  if (write(remote->pipe[1], remote->pending, len) != len)
+    return -1;
+
+  remote->pending_len = 0;
+  stats.records_received++;
+
+  return 0;
+}
+
+/* Write the waiting frames which fit, adds the pipes of devices of which a
+ * frame still waits to wait_fds. Returns the number of wait_fds in use. */
+static int write_pending_all(void)
+{
+  struct spacemouse *mouse;
+  int nfds = 1;
+
+  spacemouse_device_list(&mouse, 0);
+  for ( ; mouse != NULL; mouse = mouse->next) {
+    if (mouse->remote.pipe[0] < 0 || mouse->remote.pending_len == 0)
+      continue;
+
+    if (mouse->fd < 0)
+      mouse->remote.pending_len = 0;
+    else if (write_pending(mouse) == -1 && nfds < MAX_WAIT_FDS) {
+      wait_fds[nfds].fd = mouse->remote.pipe[1];
+      wait_fds[nfds++].events = POLLOUT;
+    }
+  }
+
+  return nfds;
+}
+
+/* Forward a record of datagram seq to the remote device as evdev events, so
+ * the normal read path decodes them. */
+static void deliver_record(struct spacemouse *mouse, unsigned long seq,
+                           unsigned char const *record)
+{
+  struct spacemouse_remote *remote = &mouse->remote;
+  struct input_event ev[7];
+  int type = record[2], n = 0, axis;
+  ssize_t len;
+
+  memset(ev, 0, sizeof ev);
+
+  switch (type) {
+    case SPACEMOUSE_EVENT_MOTION:
+      /* a newer position of the device has been delivered already */
+      if (remote->has_motion &&
+          ((seq - remote->motion_seq) & 0xffffffffUL) >= 0x80000000UL)
+        return;
+      remote->motion_seq = seq;
+      remote->has_motion = 1;
+      for (axis = 0; axis < 6; axis++, n++) {
+        ev[n].type = EV_REL;
+        ev[n].code = REL_X + axis;
+        ev[n].value = get32s(record + 20 + axis * 4);
+      }
+      break;
+
+    case SPACEMOUSE_EVENT_BUTTON:
+      ev[n].type = EV_KEY;
+      ev[n].code = BTN_0 + get32(record + 20);
+      ev[n++].value = get32s(record + 24);
+      break;
+
+    case SPACEMOUSE_EVENT_LED:
+      ev[n].type = EV_LED;
+      ev[n].code = LED_MISC;
+      ev[n++].value = get32s(record + 20);
+      break;
+
+    default:
+      stats.invalid++;
+      return;
+  }
+
+  ev[n].type = EV_SYN;
+  ev[n++].code = SYN_REPORT;
+
+  for (axis = 0; axis < n; axis++) {
+    ev[axis].time.tv_sec = get32(record + 12);
+    ev[axis].time.tv_usec = get32(record + 16);
+  }
+
+  remote->max_axis = get16(record + 4);
+
+  /* the events would be stale by the time the device is opened */
+  if (mouse->fd < 0) {
+    stats.records_dropped++;
+    return;
+  }
+
+  /* pipe writes up to PIPE_BUF are atomic, a frame is never split; a
+   * waiting frame is older and goes first */
+  len = n * sizeof *ev;
+  if (write_pending(mouse) == 0 && write(remote->pipe[1], ev, len) == len) {
+    stats.records_received++;
+    return;
+  }
+
+  /* the pipe is full: the newest motion waits for room, instead of an older
+   * waiting one, other frames can not wait */
+  if (type == SPACEMOUSE_EVENT_MOTION) {
+    if (remote->pending_len > 0)
+      stats.records_dropped++;
+    memcpy(remote->pending, ev, len);
+    remote->pending_len = n;
+  } else
+    stats.records_dropped++;
+}
+
+enum spacemouse_action spacemouse_stream_receive(struct spacemouse **mouse_ptr)
+{
+  struct spacemouse *mouse;
+  struct source *src;
+  int action = SPACEMOUSE_ACTION_IGNORE, error = 0, count, i, ret, added;
+  int timeout, nfds;
+
+  if (recv_fd < 0)
+    return -EBADF;
+
+  /* stale devices are reported first, one per call. Until a datagram comes
+   * in, devices time out and waiting frames are written once there is room */
+  while ((mouse = stale_device(&timeout)) == NULL) {
+    wait_fds[0].fd = recv_fd;
+    wait_fds[0].events = POLLIN;
+    if ((nfds = write_pending_all()) == 1 && timeout == -1)
+      break;
+
+    if ((ret = poll(wait_fds, nfds, timeout)) == -1 && errno != EINTR)
+      return -errno;
+    if (ret > 0 && wait_fds[0].revents & POLLIN)
+      break;
+  }
+
+  if (mouse != NULL) {
+    *mouse_ptr = remove_device_cached(mouse);
+    return SPACEMOUSE_ACTION_REMOVE;
+  }
+
+  for (i = 0; i < STREAM_BATCH; i++) {
+    memset(&recv_hdrs[i], 0, sizeof recv_hdrs[i]);
+    recv_hdrs[i].msg_hdr.msg_iov = &recv_iovs[i];
+    recv_hdrs[i].msg_hdr.msg_iovlen = 1;
+    recv_hdrs[i].msg_hdr.msg_name = &recv_addrs[i];
+    recv_hdrs[i].msg_hdr.msg_namelen = sizeof recv_addrs[i];
+  }
+
+  /* blocks for the first datagram only, takes what else is queued */
+  do {
+    count = recvmmsg(recv_fd, recv_hdrs, STREAM_BATCH, MSG_WAITFORONE, NULL);
+  } while (count == -1 && errno == EINTR);
+
+  if (count == -1)
+    return -errno;
+
+  for (i = 0; i < count; i++) {
+    unsigned char const *data = recv_packets[i], *record;
+    struct msghdr *hdr = &recv_hdrs[i].msg_hdr;
+    unsigned int len = recv_hdrs[i].msg_len;
+
+    if (len < HEADER_LEN || get32(data) != STREAM_MAGIC ||
+        get16(data + 4) != STREAM_VERSION ||
+        len != HEADER_LEN + get16(data + 6) * RECORD_LEN) {
+      stats.invalid++;
+      continue;
+    }
+
+    stats.packets_received++;
+
+    if ((ret = track_seq(hdr->msg_name, hdr->msg_namelen, get32(data + 8),
+                         get32(data + 12), &src)) <= 0) {
+      if (ret == -1 && error == 0)
+        error = -errno;
+      continue;
+    }
+
+    for (record = data + HEADER_LEN; record < data + len;
+         record += RECORD_LEN) {
+      /* only this record is lost, the error is returned at the end */
+      if ((mouse = remote_device(src, record, &added)) == NULL) {
+        if (error == 0 && errno != 0)
+          error = -errno;
+        continue;
+      }
+
+      /* devices added after the first are only found in the device list */
+      if (added && action != SPACEMOUSE_ACTION_ADD) {
+        action = SPACEMOUSE_ACTION_ADD;
+        *mouse_ptr = mouse;
+      }
+
+      deliver_record(mouse, get32(data + 12), record);
+    }
+  }
+
+  return action == SPACEMOUSE_ACTION_IGNORE && error < 0 ? error : action;
+}
+
+int spacemouse_stream_receiver_close(void)
+{
+  struct spacemouse *mouse, *next;
+  int ret;
+
+  if (recv_fd < 0)
+    return -EBADF;
+
+  spacemouse_device_list(&mouse, 0);
+  for ( ; mouse != NULL; mouse = next) {
+    next = mouse->next;
+    if (mouse->remote.pipe[0] > -1)
+      remove_device(mouse, 0);
+  }
+
+  ret = close(recv_fd);
+  recv_fd = -1;
+
+  return ret == -1 ? -errno : 0;
+}
+
+void spacemouse_stream_get_stats(struct spacemouse_stream_stats *stream_stats)
+{
+  memcpy(stream_stats, &stats, sizeof *stream_stats);
+}
+
+void spacemouse_stream_reset_stats(void)
+{
+  memset(&stats, 0, sizeof stats);
+}
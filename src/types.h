@@ -21,14 +21,61 @@ along with libspacemouse.  If not, see <http://www.gnu.org/licenses/>.
 #define _TYPES_H_
 
 #include <sys/time.h>
+#include <time.h>
+#include <pthread.h>
+#include <linux/input.h>
 
 #include "libspacemouse.h"
 
 struct spacemouse_buf {
   struct spacemouse_event_motion motion;
   struct timeval time;
+
+  /* kernel timestamp of the last completed frame */
+  struct timeval frame_time;
+};
+
+struct spacemouse_sample {
+  int fd;
+  long interval; /* ns */
+  struct timespec next;
+};
+
+struct spacemouse_reader {
+  pthread_t thread;
+  int running;
+  int locked;
+  int error;
+};
+
+struct spacemouse_busy_poll {
+  unsigned int max_budget; /* us, 0 when disabled */
+  long period;             /* average gap between motion reports in us */
+  int active;              /* motion is active, spin for the next report */
+};
+
+struct spacemouse_calib {
+  int enabled;
+  int valid;        /* bias holds an estimate */
+  int count;        /* frames in the current window */
+  double mean[6], m2[6];
+  double bias[6];
+};
+
+struct spacemouse_remote {
+  int pipe[2];   /* events of a streamed device, -1 for local devices */
+  int max_axis;
+  int source;    /* publisher in the receiver's table */
+  unsigned long epoch;       /* of the publisher, stale when it changed */
+  unsigned long motion_seq;  /* datagram of the last delivered motion */
+  int has_motion;
+  /* newest motion frame, waiting for room in the pipe */
+  struct input_event pending[7];
+  int pending_len;
 };
 
+struct broadcast_ring;
+
 struct spacemouse {
   int id;
   int fd;
@@ -37,11 +84,36 @@ struct spacemouse {
 
   char *devnode;
 
+  unsigned int vendor_id, product_id;
+
   char *manufacturer;
   char *product;
+  char *serial;
 
   struct spacemouse_buf buf;
 
+  struct spacemouse_sample sample;
+
+  struct spacemouse_busy_poll busy;
+
+  int max_axis;  /* cached, 0 when not yet queried */
+  int batch_type;   /* decode state of the batch reads */
+  int batch_error;  /* error after a batch of events, returned next */
+
+  struct spacemouse_calib calib;
+
+  struct spacemouse_probe probe;
+  int probed;  /* probe holds the result of SPACEMOUSE_LIST_PROBE */
+
+  struct spacemouse_remote remote;
+
+  struct spacemouse_stats stats;
+  double latency_sum, jitter_sum;
+
+  struct broadcast_ring *broadcast;
+
+  struct spacemouse_reader reader;
+
   struct spacemouse *next;
 };
 